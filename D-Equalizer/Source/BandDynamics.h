@@ -0,0 +1,186 @@
+/*
+  ==============================================================================
+
+    BandDynamics.h
+    Envelope detection for dynamic EQ bands. Each dynamic band listens to the
+    detector signal through its own band-pass and turns its gain down by
+    (1 - 1/ratio) dB for every dB the band is above its threshold.
+
+    The band-pass runs at the audio rate (decimating first would alias every
+    band above the control-rate Nyquist), but rectification only keeps the
+    peak of each group of 'decimation' samples, and the attack/release
+    ballistics run once per group. The processor turns the envelopes into
+    coefficients on its 32-sample grid, never per sample.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "ParametricBands.h"
+
+#include <array>
+
+class BandDynamics
+{
+public:
+    static constexpr int decimation = 8;
+
+    //a notch has no gain to move, so it never runs a detector
+    static bool isDynamic(const BandSettings& band)
+    {
+        return band.dynamic && ! band.bypassed && band.type != BandType::NotchBand;
+    }
+
+    //the gain a dynamic band runs at for a detector level
+    static float getDynamicGainDb(const BandSettings& band, float levelDb)
+    {
+        const auto over = juce::jmax(0.0f, levelDb - band.thresholdDb);
+        return juce::jmax(minimumGainDb, band.gainDb - over * (1.0f - 1.0f / band.ratio));
+    }
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        numActive = 0;
+
+        for( auto& detector : detectors )
+            detector = Detector();
+    }
+
+    void reset()
+    {
+        for( auto& detector : detectors )
+            detector.clear();
+    }
+
+    size_t getNumActive() const { return numActive; }
+    size_t getActiveBand(size_t i) const { return active[i]; }
+
+    //Picks up new band settings: the active list is repacked and band-pass or ballistics are
+    //only redesigned when their parameters moved. Cheap enough for every grid point.
+    void setBands(const BandArray& bands)
+    {
+        numActive = 0;
+
+        for( size_t i = 0; i < maxBands; ++i )
+        {
+            auto& detector = detectors[i];
+            const auto& band = bands[i];
+
+            if( ! isDynamic(band) )
+            {
+                detector.running = false;
+                continue;
+            }
+
+            if( ! detector.running )
+            {
+                detector.clear();
+                detector.running = true;
+            }
+
+            if( band.freq != detector.freq || band.quality != detector.quality )
+                detector.designBandPass(band.freq, band.quality, sampleRate);
+
+            if( band.attackMs != detector.attackMs || band.releaseMs != detector.releaseMs )
+                detector.designBallistics(band.attackMs, band.releaseMs, sampleRate / decimation);
+
+            active[numActive++] = i;
+        }
+    }
+
+    //runs every active detector over a mono block of the detector signal
+    void process(const float* input, int numSamples) noexcept
+    {
+        for( size_t a = 0; a < numActive; ++a )
+            detectors[active[a]].process(input, numSamples);
+    }
+
+    //replaces the gain of every dynamic band with the one its envelope asks for
+    void applyTo(BandArray& bands) const
+    {
+        for( size_t a = 0; a < numActive; ++a )
+        {
+            auto& band = bands[active[a]];
+            band.gainDb = getDynamicGainDb(band, detectors[active[a]].getLevelDb());
+        }
+    }
+
+private:
+    static constexpr float minimumGainDb = -30.0f;
+
+    struct Detector
+    {
+        //constant 0 dB peak gain band-pass (b1 is always 0, b2 = -b0)
+        void designBandPass(float frequency, float q, double rate)
+        {
+            freq = frequency;
+            quality = q;
+
+            const auto omega = juce::MathConstants<float>::twoPi * juce::jlimit(2.0f, 0.49f * (float) rate, frequency) / (float) rate;
+            const auto alpha = std::sin(omega) / (2.0f * q);
+            const auto a0Inverse = 1.0f / (1.0f + alpha);
+
+            b0 = alpha * a0Inverse;
+            a1 = -2.0f * std::cos(omega) * a0Inverse;
+            a2 = (1.0f - alpha) * a0Inverse;
+        }
+
+        void designBallistics(float attack, float release, double controlRate)
+        {
+            attackMs = attack;
+            releaseMs = release;
+            attackCoefficient = 1.0f - (float) std::exp(-1000.0 / (juce::jmax(0.1f, attack) * controlRate));
+            releaseCoefficient = 1.0f - (float) std::exp(-1000.0 / (juce::jmax(0.1f, release) * controlRate));
+        }
+
+        void clear()
+        {
+            s1 = s2 = 0.0f;
+            envelope = groupPeak = 0.0f;
+            groupCount = 0;
+        }
+
+        void process(const float* input, int numSamples) noexcept
+        {
+            for( int i = 0; i < numSamples; ++i )
+            {
+                //transposed direct form II
+                const auto bandPassed = b0 * input[i] + s1;
+                s1 = s2 - a1 * bandPassed;
+                s2 = -b0 * input[i] - a2 * bandPassed;
+
+                groupPeak = juce::jmax(groupPeak, std::abs(bandPassed));
+
+                if( ++groupCount == decimation )
+                {
+                    const auto coefficient = groupPeak > envelope ? attackCoefficient : releaseCoefficient;
+                    envelope += coefficient * (groupPeak - envelope);
+                    groupPeak = 0.0f;
+                    groupCount = 0;
+                }
+            }
+
+            juce::dsp::util::snapToZero(s1);
+            juce::dsp::util::snapToZero(s2);
+        }
+
+        float getLevelDb() const { return juce::Decibels::gainToDecibels(envelope, -100.0f); }
+
+        float b0 = 0.0f, a1 = 0.0f, a2 = 0.0f, s1 = 0.0f, s2 = 0.0f;
+        float attackCoefficient = 1.0f, releaseCoefficient = 1.0f;
+        float envelope = 0.0f, groupPeak = 0.0f;
+        int groupCount = 0;
+
+        //what the coefficients were designed for; 0 forces the first design
+        float freq = 0.0f, quality = 0.0f, attackMs = 0.0f, releaseMs = 0.0f;
+        bool running = false;
+    };
+
+    double sampleRate = 44100.0;
+    std::array<Detector, maxBands> detectors;
+    std::array<size_t, maxBands> active {};
+    size_t numActive = 0;
+};
@@ -0,0 +1,271 @@
+/*
+  ==============================================================================
+
+    Benchmarks.cpp
+
+  ==============================================================================
+*/
+
+#include "Benchmarks.h"
+#include "BandDynamics.h"
+
+//with an oversampling order, the chains run at that multiple of sampleRate between the resamplers
+template<typename ChainType>
+static double timeChains(bool modulated, double sampleRate, int blockSize, int numBlocks, int oversamplingOrder = 0)
+{
+    std::unique_ptr<juce::dsp::Oversampling<float>> oversampling;
+    
+    if (oversamplingOrder > 0) {
+        oversampling = std::make_unique<juce::dsp::Oversampling<float>>(2, (size_t) oversamplingOrder,
+                                                                        juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR,
+                                                                        true);
+        oversampling->initProcessing((size_t) blockSize);
+    }
+    
+    const auto factor = 1 << oversamplingOrder;
+    const auto rate = sampleRate * factor;
+    
+    ChainType left, right;
+    shareResponses(left, right);
+    
+    ChainSettings settings;
+    settings.lowCutFreq = 80.0f;
+    settings.highCutFreq = 12000.0f;
+    settings.lowCutSlope = settings.highCutSlope = Slope_48;
+    settings.bands[0].freq = 1000.0f;
+    settings.bands[0].gainDb = 6.0f;
+    settings.bands[0].bypassed = false;
+    
+    left.template get<ChainPositions::Bands>().setActiveBands(settings.bands);
+    right.template get<ChainPositions::Bands>().setActiveBands(settings.bands);
+    
+    auto design = [&left, &settings, rate]()
+    {
+        designCutFilter(left.template get<ChainPositions::LowCut>(), settings.lowCutFreq, settings.lowCutSlope, true, rate);
+        designBand(left.template get<ChainPositions::Bands>().getBand(0), settings.bands[0], rate);
+        designCutFilter(left.template get<ChainPositions::HighCut>(), settings.highCutFreq, settings.highCutSlope, false, rate);
+    };
+    design();
+    
+    juce::dsp::ProcessSpec spec { rate, (juce::uint32) (blockSize * factor), 1 };
+    left.prepare(spec);
+    right.prepare(spec);
+    
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::Random random (0x0de9);
+    for (int ch = 0; ch < 2; ++ch)
+        for (int i = 0; i < blockSize; ++i)
+            buffer.setSample(ch, i, random.nextFloat() * 0.5f - 0.25f);
+    
+    juce::dsp::AudioBlock<float> block (buffer);
+    double phase = 0.0;
+    
+    const auto start = juce::Time::getHighResolutionTicks();
+    
+    for (int b = 0; b < numBlocks; ++b) {
+        auto processed = oversampling != nullptr ? oversampling->processSamplesUp(block) : block;
+        const auto numSamples = (int) processed.getNumSamples();
+        const auto subBlockSize = modulated ? 32 : numSamples;
+        
+        for (int offset = 0; offset < numSamples; offset += subBlockSize) {
+            const auto length = juce::jmin(subBlockSize, numSamples - offset);
+            
+            if (modulated) {
+                //a 0.5 Hz sweep over three octaves
+                phase += juce::MathConstants<double>::twoPi * 0.5 * length / rate;
+                const auto sweep = (float) std::pow(2.0, 1.5 * std::sin(phase));
+                settings.bands[0].freq = 1000.0f * sweep;
+                settings.lowCutFreq = 160.0f * sweep;
+                settings.highCutFreq = 5000.0f * sweep;
+                design();
+            }
+            
+            auto leftBlock = processed.getSingleChannelBlock(0).getSubBlock((size_t) offset, (size_t) length);
+            auto rightBlock = processed.getSingleChannelBlock(1).getSubBlock((size_t) offset, (size_t) length);
+            left.process(juce::dsp::ProcessContextReplacing<float>(leftBlock));
+            right.process(juce::dsp::ProcessContextReplacing<float>(rightBlock));
+        }
+        
+        if (oversampling != nullptr)
+            oversampling->processSamplesDown(block);
+    }
+    
+    const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    return elapsed * 1.0e9 / ((double) numBlocks * blockSize);
+}
+
+std::vector<TopologyBenchmarkResult> benchmarkFilterTopologies(double sampleRate, int blockSize, int numBlocks)
+{
+    std::vector<TopologyBenchmarkResult> results;
+    
+    for (auto modulated : { false, true }) {
+        results.push_back({ FilterTopology::Biquad, modulated, timeChains<MonoChain>(modulated, sampleRate, blockSize, numBlocks) });
+        results.push_back({ FilterTopology::StateVariable, modulated, timeChains<SvfMonoChain>(modulated, sampleRate, blockSize, numBlocks) });
+    }
+    
+    return results;
+}
+
+//runs a stereo pair of cut stages, designed with the given number of sections, over noise
+static double timeCutFilters(CutFilter& left, CutFilter& right, size_t numSections, juce::AudioBuffer<float>& buffer, int numBlocks)
+{
+    setActiveSections(left, numSections);
+    setActiveSections(right, numSections);
+    left.reset();
+    right.reset();
+    
+    juce::Random random (0x0de9);
+    for (int ch = 0; ch < 2; ++ch)
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+            buffer.setSample(ch, i, random.nextFloat() * 0.5f - 0.25f);
+    
+    juce::dsp::AudioBlock<float> block (buffer);
+    auto leftBlock = block.getSingleChannelBlock(0);
+    auto rightBlock = block.getSingleChannelBlock(1);
+    
+    const auto start = juce::Time::getHighResolutionTicks();
+    
+    for (int b = 0; b < numBlocks; ++b) {
+        left.process(juce::dsp::ProcessContextReplacing<float>(leftBlock));
+        right.process(juce::dsp::ProcessContextReplacing<float>(rightBlock));
+    }
+    
+    const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    return elapsed * 1.0e9 / ((double) numBlocks * buffer.getNumSamples());
+}
+
+std::vector<SlopeBenchmarkResult> benchmarkCutSlopes(double sampleRate, int blockSize, int numBlocks)
+{
+    std::vector<SlopeBenchmarkResult> results;
+    
+    CutFilter left, right;
+    shareCutResponses(left, right);
+    
+    juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32) blockSize, 1 };
+    left.prepare(spec);
+    right.prepare(spec);
+    
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    
+    for (int slope = Slope_12; slope <= Slope_96; ++slope) {
+        const auto numSections = designCutFilter(left, 30.0f, static_cast<Slope>(slope), true, sampleRate);
+        results.push_back({ static_cast<Slope>(slope), timeCutFilters(left, right, numSections, buffer, numBlocks) });
+    }
+    
+    return results;
+}
+
+std::vector<CutFamilyBenchmarkResult> benchmarkCutFamilies(const CutShape& shape, double sampleRate, int blockSize, int numBlocks)
+{
+    std::vector<CutFamilyBenchmarkResult> results;
+    
+    CutFilter left, right;
+    shareCutResponses(left, right);
+    
+    juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32) blockSize, 1 };
+    left.prepare(spec);
+    right.prepare(spec);
+    
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    
+    //Butterworth runs at its steepest slope, the others at the requested width and attenuation
+    for (int family = Butterworth; family <= Elliptic; ++family) {
+        auto familyShape = shape;
+        familyShape.family = static_cast<CutFamily>(family);
+        
+        const auto numSections = designCutFilter(left, 16000.0f, Slope_96, familyShape, false, sampleRate);
+        results.push_back({ familyShape, numSections, timeCutFilters(left, right, numSections, buffer, numBlocks) });
+    }
+    
+    return results;
+}
+
+std::vector<DynamicBandsBenchmarkResult> benchmarkDynamicBands(size_t numBands, double sampleRate, int blockSize, int numBlocks)
+{
+    std::vector<DynamicBandsBenchmarkResult> results;
+    numBands = juce::jmin(numBands, maxBands);
+    
+    juce::AudioBuffer<float> buffer (2, blockSize), detectorInput (1, blockSize);
+    juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32) blockSize, 1 };
+    
+    for (auto dynamic : { false, true }) {
+        ParametricBands<Filter> left, right;
+        shareBandResponses(left, right);
+        left.prepare(spec);
+        right.prepare(spec);
+        
+        //peak bands a third of an octave apart from 50 Hz, their detectors keyed hard by the noise
+        BandArray bands;
+        for (size_t band = 0; band < numBands; ++band) {
+            bands[band].freq = 50.0f * std::pow(2.0f, (float) band / 3.0f);
+            bands[band].gainDb = 3.0f;
+            bands[band].bypassed = false;
+            bands[band].dynamic = dynamic;
+            bands[band].thresholdDb = -40.0f;
+            designBand(left.getBand(band), bands[band], sampleRate);
+        }
+        left.setActiveBands(bands);
+        right.setActiveBands(bands);
+        
+        BandDynamics dynamics;
+        dynamics.prepare(sampleRate);
+        dynamics.setBands(bands);
+        
+        juce::Random random (0x0de9);
+        for (int ch = 0; ch < 2; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                buffer.setSample(ch, i, random.nextFloat() * 0.5f - 0.25f);
+        
+        juce::dsp::AudioBlock<float> block (buffer);
+        
+        const auto start = juce::Time::getHighResolutionTicks();
+        
+        for (int b = 0; b < numBlocks; ++b) {
+            //what EQEngine::process does: detect, redesign on the grid, filter
+            for (int offset = 0; offset < blockSize; offset += 32) {
+                const auto length = juce::jmin(32, blockSize - offset);
+                
+                if (dynamic) {
+                    auto* mono = detectorInput.getWritePointer(0);
+                    for (int i = 0; i < length; ++i)
+                        mono[i] = 0.5f * (buffer.getSample(0, offset + i) + buffer.getSample(1, offset + i));
+                    
+                    dynamics.process(mono, length);
+                    
+                    auto dynamicBands = bands;
+                    dynamics.applyTo(dynamicBands);
+                    for (size_t a = 0; a < dynamics.getNumActive(); ++a)
+                        designBand(left.getBand(dynamics.getActiveBand(a)), dynamicBands[dynamics.getActiveBand(a)], sampleRate);
+                }
+                
+                auto leftBlock = block.getSingleChannelBlock(0).getSubBlock((size_t) offset, (size_t) length);
+                auto rightBlock = block.getSingleChannelBlock(1).getSubBlock((size_t) offset, (size_t) length);
+                left.process(juce::dsp::ProcessContextReplacing<float>(leftBlock));
+                right.process(juce::dsp::ProcessContextReplacing<float>(rightBlock));
+            }
+        }
+        
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        results.push_back({ dynamic, numBands, elapsed * 1.0e9 / ((double) numBlocks * blockSize) });
+    }
+    
+    return results;
+}
+
+std::vector<OversamplingBenchmarkResult> benchmarkOversampling(double sampleRate, int blockSize, int numBlocks)
+{
+    std::vector<OversamplingBenchmarkResult> results;
+    double baseline = 0.0;
+    
+    //the plugin's orders: off, 2x and 4x
+    for (int order = 0; order <= 2; ++order) {
+        const auto nanoseconds = timeChains<MonoChain>(false, sampleRate, blockSize, numBlocks, order);
+        
+        if (order == 0)
+            baseline = nanoseconds;
+        
+        results.push_back({ 1 << order, nanoseconds, nanoseconds / baseline });
+    }
+    
+    return results;
+}
@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    Benchmarks.h
+    Timings of the filter chains and their stages, with no plugin around them.
+
+    deq-render --bench runs them all and prints the results; they are not
+    compiled into the plugin.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "ChainDesign.h"
+
+#include <vector>
+
+//cost of a stereo pair of chains (48 dB/oct cuts and one peak band), with static parameters
+//and with the peak and cut frequencies swept on the 32-sample smoothing grid
+struct TopologyBenchmarkResult
+{
+    FilterTopology topology;
+    bool modulated;
+    double nanosecondsPerSample;
+};
+
+std::vector<TopologyBenchmarkResult> benchmarkFilterTopologies(double sampleRate, int blockSize, int numBlocks);
+
+//cost of one biquad cut stage of maxCutSections sections at every slope
+struct SlopeBenchmarkResult
+{
+    Slope slope;
+    double nanosecondsPerSample;
+};
+
+std::vector<SlopeBenchmarkResult> benchmarkCutSlopes(double sampleRate, int blockSize, int numBlocks);
+
+//cost of one biquad cut stage of each family, for the same transition width and attenuation
+struct CutFamilyBenchmarkResult
+{
+    CutShape shape;
+    size_t numSections;
+    double nanosecondsPerSample;
+};
+
+std::vector<CutFamilyBenchmarkResult> benchmarkCutFamilies(const CutShape& shape, double sampleRate, int blockSize, int numBlocks);
+
+//cost of a stereo pair of band stages with numBands peak bands, static and dynamic
+struct DynamicBandsBenchmarkResult
+{
+    bool dynamic;
+    size_t numBands;
+    double nanosecondsPerSample;
+};
+
+std::vector<DynamicBandsBenchmarkResult> benchmarkDynamicBands(size_t numBands, double sampleRate, int blockSize, int numBlocks);
+
+//cost of the static benchmarkFilterTopologies biquad chains at each oversampling factor,
+//resampling included, per host sample; cpuMultiplier is relative to no oversampling
+struct OversamplingBenchmarkResult
+{
+    int factor;                     //1, 2 or 4
+    double nanosecondsPerSample;
+    double cpuMultiplier;
+};
+
+std::vector<OversamplingBenchmarkResult> benchmarkOversampling(double sampleRate, int blockSize, int numBlocks);
@@ -0,0 +1,381 @@
+/*
+  ==============================================================================
+
+    ChainDesign.cpp
+
+  ==============================================================================
+*/
+
+#include "ChainDesign.h"
+#include "ParameterTable.h"
+
+void designCrossover(LinkwitzRileyCrossover& crossover, const CrossoverSettings& settings, double sampleRate)
+{
+    const auto slope = settings.steep ? Slope_24 : Slope_12;
+    const auto& inverseQs = getButterworthInverseQs(slope);
+    const auto numSections = getNumSections(slope);
+    
+    crossover.setLayout(settings.numBands, numSections);
+    
+    //the splits are kept in order and below Nyquist, whatever the parameters say
+    auto frequency = 10.0f;
+    for (size_t i = 0; i + 1 < settings.numBands; ++i) {
+        frequency = juce::jlimit(frequency, 0.45f * (float) sampleRate, settings.frequencies[i]);
+        
+        const auto normalisedFrequency = frequency / (float) sampleRate;
+        const auto t = std::tan(juce::MathConstants<float>::pi * normalisedFrequency);
+        const CutDesign lowPass { normalisedFrequency, 1.0f / t, false };
+        const CutDesign highPass { normalisedFrequency, t, true };
+        
+        auto& split = crossover.getSplit(i);
+        for (size_t s = 0; s < numSections; ++s) {
+            designCutSection(split.lowPass[s].data(), lowPass, inverseQs[s]);
+            designCutSection(split.highPass[s].data(), highPass, inverseQs[s]);
+            designAllPassSection(split.allPass[s].data(), lowPass, inverseQs[s]);
+        }
+    }
+    
+    bool anySoloed = false;
+    for (size_t band = 0; band < settings.numBands; ++band)
+        anySoloed = anySoloed || settings.soloed[band];
+    
+    std::array<float, maxCrossoverBands> gains {};
+    for (size_t band = 0; band < settings.numBands; ++band) {
+        const auto audible = ! settings.muted[band] && (! anySoloed || settings.soloed[band]);
+        gains[band] = audible ? juce::Decibels::decibelsToGain(settings.gainDb[band]) : 0.0f;
+    }
+    
+    crossover.setBandGains(gains);
+}
+
+Coefficients makeBandFilter(const BandSettings& band, double sampleRate)
+{
+    Filter filter;
+    filter.coefficients = new juce::dsp::IIR::Coefficients<float>(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+    designBand(filter, band, sampleRate);
+    return filter.coefficients;
+}
+
+const CutPrototype& getCutPrototype(const CutShape& shape)
+{
+    using Design = juce::dsp::FilterDesign<double>;
+    
+    static const auto table = []
+    {
+        std::array<std::array<std::array<CutPrototype, 3>, 3>, 4> prototypes;
+        
+        for (int family = Chebyshev1; family <= Elliptic; ++family) {
+            for (int transition = Transition_HalfOctave; transition <= Transition_TwoOctaves; ++transition) {
+                for (int attenuation = Attenuation_48; attenuation <= Attenuation_96; ++attenuation) {
+                    //designed at a sample rate of 1: the passband edge sits at 0.25, and the stop band
+                    //starts where the prewarped frequency is 2^octaves times the edge's
+                    const auto octaves = transition == Transition_HalfOctave ? 0.5 : (double) transition;
+                    const auto width = std::atan(std::pow(2.0, octaves)) / juce::MathConstants<double>::pi - 0.25;
+                    const auto stopbandDb = -48.0 - 24.0 * attenuation;
+                    const auto centre = 0.25 + width / 2.0;
+                    
+                    juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<double>> sections;
+                    if (family == Chebyshev1)
+                        sections = Design::designIIRLowpassHighOrderChebyshev1Method(centre, 1.0, width, -0.1, stopbandDb);
+                    else if (family == Chebyshev2)
+                        sections = Design::designIIRLowpassHighOrderChebyshev2Method(centre, 1.0, width, -0.1, stopbandDb);
+                    else
+                        sections = Design::designIIRLowpassHighOrderEllipticMethod(centre, 1.0, width, -0.1, stopbandDb);
+                    
+                    //every combination fits, the steepest Chebyshev needs order 16
+                    jassert((size_t) sections.size() <= maxCutSections);
+                    
+                    auto& prototype = prototypes[family][transition][attenuation];
+                    prototype.numSections = juce::jmin(maxCutSections, (size_t) sections.size());
+                    
+                    for (size_t i = 0; i < prototype.numSections; ++i) {
+                        const auto* c = sections.getUnchecked((int) i)->getRawCoefficients();
+                        
+                        if (sections.getUnchecked((int) i)->getFilterOrder() == 1)
+                            prototype.sections[i] = { c[0], c[1], 0.0, c[2], 0.0 };
+                        else
+                            prototype.sections[i] = { c[0], c[1], c[2], c[3], c[4] };
+                    }
+                }
+            }
+        }
+        
+        return prototypes;
+    }();
+    
+    jassert(shape.family != CutFamily::Butterworth);
+    return table[shape.family][shape.transition][shape.attenuation];
+}
+
+static CutCoefficients makeCutFilter(float frequency, const Slope& slope, const CutShape& shape, bool highPass, double sampleRate)
+{
+    using Design = juce::dsp::FilterDesign<float>;
+    
+    if (shape.family == CutFamily::Butterworth) {
+        const auto order = (int) getNumSections(slope) * 2;
+        return highPass ? Design::designIIRHighpassHighOrderButterworthMethod(frequency, sampleRate, order)
+                        : Design::designIIRLowpassHighOrderButterworthMethod(frequency, sampleRate, order);
+    }
+    
+    const auto& prototype = getCutPrototype(shape);
+    const auto alpha = getCutTransformAlpha(frequency, highPass, sampleRate);
+    
+    CutCoefficients coefficients;
+    for (size_t i = 0; i < prototype.numSections; ++i) {
+        auto* section = new juce::dsp::IIR::Coefficients<float>(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+        transformCutSection(prototype.sections[i], alpha, highPass, section->getRawCoefficients());
+        coefficients.add(section);
+    }
+    
+    return coefficients;
+}
+
+CutCoefficients makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate)
+{
+    return makeCutFilter(chainSettings.lowCutFreq, chainSettings.lowCutSlope, chainSettings.lowCutShape, true, sampleRate);
+}
+
+CutCoefficients makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate)
+{
+    return makeCutFilter(chainSettings.highCutFreq, chainSettings.highCutSlope, chainSettings.highCutShape, false, sampleRate);
+}
+
+void setChainResponse(MonoChain& chain, ChainSettings chainSettings, double sampleRate, int channel)
+{
+    chain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    chain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    
+    auto& bands = chain.get<ChainPositions::Bands>();
+    for (size_t band = 0; band < maxBands; ++band) {
+        if (!chainSettings.bands[band].bypassed) {
+            auto bandCoefficients = makeBandFilter(chainSettings.bands[band], sampleRate);
+            updateCoefficients(bands.getBand(band).coefficients, bandCoefficients);
+        }
+    }
+    if (channel < 0)
+        bands.setActiveBands(chainSettings.bands);
+    else
+        bands.setActiveBands(chainSettings.bands, (size_t) channel, chainSettings.channelMode == ChannelMode::StereoLinked);
+    
+    //the state-variable cuts only come as Butterworth, match what is actually running
+    if (chainSettings.topology == FilterTopology::StateVariable)
+        chainSettings.lowCutShape.family = chainSettings.highCutShape.family = CutFamily::Butterworth;
+    
+    updateCutFilter(chain.get<ChainPositions::LowCut>(), makeLowCutFilter(chainSettings, sampleRate));
+    updateCutFilter(chain.get<ChainPositions::HighCut>(), makeHighCutFilter(chainSettings, sampleRate));
+}
+
+double getChainMagnitude(const MonoChain& chain, double frequency, double sampleRate)
+{
+    double magnitude = 1.0;
+    
+    const auto& bands = chain.get<ChainPositions::Bands>();
+    for (size_t b = 0; b < bands.getNumActiveBands(); ++b)
+        magnitude *= bands.getBand(bands.getActiveBand(b)).coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+    
+    auto addCutMagnitude = [&magnitude, frequency, sampleRate](const auto& cut)
+    {
+        forEachSection(cut, [&cut, &magnitude, frequency, sampleRate](const auto& section, auto index)
+        {
+            if (!cut.template isBypassed<decltype(index)::value>())
+                magnitude *= section.coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+        });
+    };
+    
+    if (!chain.isBypassed<ChainPositions::LowCut>())
+        addCutMagnitude(chain.get<ChainPositions::LowCut>());
+    
+    if (!chain.isBypassed<ChainPositions::HighCut>())
+        addCutMagnitude(chain.get<ChainPositions::HighCut>());
+    
+    return magnitude;
+}
+
+juce::AudioBuffer<float> designLinearPhaseFir(const MonoChain& chain, int firOrder, double sampleRate)
+{
+    const auto size = 1 << firOrder;
+    
+    //a real spectrum has zero phase: its inverse transform is symmetric around sample 0
+    std::vector<float> data ((size_t) size * 2, 0.0f);
+    for (int k = 0; k <= size / 2; ++k)
+        data[(size_t) k * 2] = (float) getChainMagnitude(chain, k * sampleRate / size, sampleRate);
+    
+    juce::dsp::FFT fft (firOrder);
+    fft.performRealOnlyInverseTransform(data.data());
+    
+    //an odd number of taps, so the response is symmetric around the middle one
+    const auto numTaps = size - 1;
+    const auto centre = numTaps / 2;
+    
+    juce::AudioBuffer<float> fir (1, numTaps);
+    auto* taps = fir.getWritePointer(0);
+    for (int i = 0; i < numTaps; ++i)
+        taps[i] = data[(size_t) ((i - centre + size) % size)];
+    
+    juce::dsp::WindowingFunction<float> window ((size_t) numTaps, juce::dsp::WindowingFunction<float>::blackman, false);
+    window.multiplyWithWindowingTable(taps, (size_t) numTaps);
+    
+    return fir;
+}
+
+void updateCoefficients(Coefficients &old, const Coefficients &replacements)
+{
+    *old = *replacements;
+}
+
+//the RBJ cookbook formulas, as used by IIR::Coefficients
+void designBand(Filter& filter, const BandSettings& band, double sampleRate)
+{
+    jassert(filter.coefficients->getFilterOrder() == 2);
+    
+    //A is the square root of decibelsToGain(gainDb)
+    const auto A = std::pow(10.0f, band.gainDb / 40.0f);
+    const auto omega = juce::MathConstants<float>::twoPi * juce::jmax(band.freq, 2.0f) / (float) sampleRate;
+    const auto alpha = std::sin(omega) / (2.0f * band.quality);
+    const auto cosOmega = std::cos(omega);
+    
+    float b0, b1, b2, a0, a1, a2;
+    
+    switch (band.type) {
+        case BandType::PeakBand:
+            b0 = 1.0f + alpha * A;
+            b1 = -2.0f * cosOmega;
+            b2 = 1.0f - alpha * A;
+            a0 = 1.0f + alpha / A;
+            a1 = -2.0f * cosOmega;
+            a2 = 1.0f - alpha / A;
+            break;
+            
+        case BandType::LowShelfBand: {
+            const auto beta = 2.0f * std::sqrt(A) * alpha;
+            b0 = A * ((A + 1.0f) - (A - 1.0f) * cosOmega + beta);
+            b1 = 2.0f * A * ((A - 1.0f) - (A + 1.0f) * cosOmega);
+            b2 = A * ((A + 1.0f) - (A - 1.0f) * cosOmega - beta);
+            a0 = (A + 1.0f) + (A - 1.0f) * cosOmega + beta;
+            a1 = -2.0f * ((A - 1.0f) + (A + 1.0f) * cosOmega);
+            a2 = (A + 1.0f) + (A - 1.0f) * cosOmega - beta;
+            break;
+        }
+            
+        case BandType::NotchBand:
+            b0 = 1.0f;
+            b1 = -2.0f * cosOmega;
+            b2 = 1.0f;
+            a0 = 1.0f + alpha;
+            a1 = -2.0f * cosOmega;
+            a2 = 1.0f - alpha;
+            break;
+            
+        case BandType::HighShelfBand:
+        case BandType::TiltBand:
+        default: {
+            const auto beta = 2.0f * std::sqrt(A) * alpha;
+            b0 = A * ((A + 1.0f) + (A - 1.0f) * cosOmega + beta);
+            b1 = -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cosOmega);
+            b2 = A * ((A + 1.0f) + (A - 1.0f) * cosOmega - beta);
+            a0 = (A + 1.0f) - (A - 1.0f) * cosOmega + beta;
+            a1 = 2.0f * ((A - 1.0f) - (A + 1.0f) * cosOmega);
+            a2 = (A + 1.0f) - (A - 1.0f) * cosOmega - beta;
+            
+            //the tilt is a high shelf turned down by half its gain
+            if (band.type == BandType::TiltBand) {
+                b0 /= A;
+                b1 /= A;
+                b2 /= A;
+            }
+            break;
+        }
+    }
+    
+    const auto a0Inverse = 1.0f / a0;
+    
+    auto* c = filter.coefficients->getRawCoefficients();
+    c[0] = b0 * a0Inverse;
+    c[1] = b1 * a0Inverse;
+    c[2] = b2 * a0Inverse;
+    c[3] = a1 * a0Inverse;
+    c[4] = a2 * a0Inverse;
+}
+
+void designBand(SvfFilter& filter, const BandSettings& band, double sampleRate)
+{
+    const auto frequency = band.freq / (float) sampleRate;
+    auto& parameters = *filter.parameters;
+    
+    switch (band.type) {
+        case BandType::PeakBand:      parameters.setBell(frequency, band.quality, band.gainDb); break;
+        case BandType::LowShelfBand:  parameters.setLowShelf(frequency, band.quality, band.gainDb); break;
+        case BandType::HighShelfBand: parameters.setHighShelf(frequency, band.quality, band.gainDb); break;
+        case BandType::NotchBand:     parameters.setNotch(frequency, band.quality); break;
+        case BandType::TiltBand:      parameters.setTilt(frequency, band.quality, band.gainDb); break;
+        default: jassertfalse; break;
+    }
+}
+
+static float morphLinear(float from, float to, float amount)
+{
+    return from + (to - from) * amount;
+}
+
+//along a log scale, for frequencies, Q and times; both ends are positive
+static float morphLog(float from, float to, float amount)
+{
+    return from * std::pow(to / from, amount);
+}
+
+static BandSettings morphBand(const BandSettings& from, const BandSettings& to, float amount)
+{
+    if (from.bypassed && to.bypassed)
+        return amount < 0.5f ? from : to;
+    
+    //a band on one side only keeps its settings and fades its gain towards 0 dB;
+    //a notch has no gain to fade and switches half way
+    if (from.bypassed || to.bypassed) {
+        auto band = from.bypassed ? to : from;
+        const auto weight = from.bypassed ? amount : 1.0f - amount;
+        band.gainDb *= weight;
+        band.bypassed = band.type == BandType::NotchBand ? weight < 0.5f : weight <= 0.0f;
+        return band;
+    }
+    
+    auto band = amount < 0.5f ? from : to;
+    band.freq = morphLog(from.freq, to.freq, amount);
+    band.gainDb = morphLinear(from.gainDb, to.gainDb, amount);
+    band.quality = morphLog(from.quality, to.quality, amount);
+    band.thresholdDb = morphLinear(from.thresholdDb, to.thresholdDb, amount);
+    band.ratio = morphLog(from.ratio, to.ratio, amount);
+    band.attackMs = morphLog(from.attackMs, to.attackMs, amount);
+    band.releaseMs = morphLog(from.releaseMs, to.releaseMs, amount);
+    return band;
+}
+
+//a cut on one side only slides out to the edge of the frequency range and switches off there
+static void morphCut(float& freq, bool& bypassed, float fromFreq, bool fromBypassed, float toFreq, bool toBypassed,
+                     float edge, float amount)
+{
+    freq = morphLog(fromBypassed ? edge : fromFreq, toBypassed ? edge : toFreq, amount);
+    
+    if (fromBypassed && toBypassed)
+        bypassed = true;
+    else if (fromBypassed)
+        bypassed = amount <= 0.0f;
+    else
+        bypassed = toBypassed && amount >= 1.0f;
+}
+
+ChainSettings morphChainSettings(const ChainSettings& from, const ChainSettings& to, float amount)
+{
+    amount = juce::jlimit(0.0f, 1.0f, amount);
+    
+    auto settings = amount < 0.5f ? from : to;
+    
+    morphCut(settings.lowCutFreq, settings.lowCutBypassed, from.lowCutFreq, from.lowCutBypassed,
+             to.lowCutFreq, to.lowCutBypassed, globalParameterSpecs[Param_LowCutFreq].minimum, amount);
+    morphCut(settings.highCutFreq, settings.highCutBypassed, from.highCutFreq, from.highCutBypassed,
+             to.highCutFreq, to.highCutBypassed, globalParameterSpecs[Param_HighCutFreq].maximum, amount);
+    
+    for (size_t band = 0; band < maxBands; ++band)
+        settings.bands[band] = morphBand(from.bands[band], to.bands[band], amount);
+    
+    return settings;
+}
@@ -0,0 +1,505 @@
+/*
+  ==============================================================================
+
+    ChainDesign.h
+    The filter chains and everything that designs them: cut and band stages,
+    their settings, the coefficient designers for the audio thread, the
+    response of a whole chain and the Linkwitz-Riley crossover design.
+
+    Plain DSP over juce_dsp. Nothing here knows about the plugin, its
+    parameters or its host, so EQEngine and the tools built on it share
+    these with EQAudioProcessor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "Crossover.h"
+#include "ParametricBands.h"
+#include "SvfFilter.h"
+
+#include <array>
+#include <utility>
+
+// MonoChain
+using Filter = juce::dsp::IIR::Filter<float>;
+
+//A cut stage is a series of second-order sections, 12 dB/oct each.
+//The number of sections is part of its type.
+constexpr size_t maxCutSections = 8;
+
+template<typename SectionType, typename Indices>
+struct CutChainBuilder;
+
+template<typename SectionType, size_t... Indices>
+struct CutChainBuilder<SectionType, std::index_sequence<Indices...>>
+{
+    template<size_t>
+    using Section = SectionType;
+    
+    using Type = juce::dsp::ProcessorChain<Section<Indices>...>;
+};
+
+template<typename SectionType, size_t NumSections = maxCutSections>
+using CutFilterOf = typename CutChainBuilder<SectionType, std::make_index_sequence<NumSections>>::Type;
+
+template<typename ChainType>
+struct NumSectionsOf;
+
+template<typename... Sections>
+struct NumSectionsOf<juce::dsp::ProcessorChain<Sections...>> : std::integral_constant<size_t, sizeof...(Sections)> {};
+
+//calls function(section, index) for every section of a cut stage, the index as a std::integral_constant
+template<typename ChainType, typename Function, size_t... Indices>
+void forEachSection(ChainType& chain, Function&& function, std::index_sequence<Indices...>)
+{
+    (void) std::initializer_list<int> { (function(chain.template get<(int) Indices>(), std::integral_constant<size_t, Indices>()), 0)... };
+}
+
+template<typename ChainType, typename Function>
+void forEachSection(ChainType& chain, Function&& function)
+{
+    forEachSection(chain, std::forward<Function>(function), std::make_index_sequence<NumSectionsOf<ChainType>::value>());
+}
+
+template<typename SectionType>
+using MonoChainOf = juce::dsp::ProcessorChain<CutFilterOf<SectionType>, ParametricBands<SectionType>, CutFilterOf<SectionType>>;
+using CutFilter = CutFilterOf<Filter>;
+using MonoChain = MonoChainOf<Filter>;
+
+//The same chain built from state-variable sections, for heavy modulation
+using SvfCutFilter = CutFilterOf<SvfFilter>;
+using SvfMonoChain = MonoChainOf<SvfFilter>;
+
+enum FilterTopology
+{
+    Biquad,
+    StateVariable
+};
+
+//How the two chains are fed. Linked, both run every band on left and right. Mid/Side runs
+//the chains on the mid and side signals, Left/Right on the untouched channels; either way
+//each band runs on the path its BandChannel picks, so each path has its own bands.
+enum ChannelMode
+{
+    StereoLinked,
+    MidSide,
+    LeftRightUnlinked
+};
+
+enum ChainPositions
+{
+    LowCut,
+    Bands,
+    HighCut
+};
+
+enum Slope
+{
+    Slope_12,
+    Slope_24,
+    Slope_36,
+    Slope_48,
+    Slope_60,
+    Slope_72,
+    Slope_84,
+    Slope_96
+};
+
+//sections in use for a slope
+inline size_t getNumSections(const Slope& slope)
+{
+    return (size_t) slope + 1;
+}
+
+//Response family of a cut stage. Butterworth follows the Slope parameter; the others are
+//specified by transition width and stop-band attenuation, and reach that rejection with
+//far fewer sections.
+enum CutFamily
+{
+    Butterworth,
+    Chebyshev1,
+    Chebyshev2,
+    Elliptic
+};
+
+//octaves between the cutoff (the edge of a 0.1 dB passband) and the start of the stop band
+enum CutTransition
+{
+    Transition_HalfOctave,
+    Transition_Octave,
+    Transition_TwoOctaves
+};
+
+enum CutAttenuation
+{
+    Attenuation_48,
+    Attenuation_72,
+    Attenuation_96
+};
+
+struct CutShape
+{
+    CutFamily family {CutFamily::Butterworth};
+    CutTransition transition {CutTransition::Transition_Octave};
+    CutAttenuation attenuation {CutAttenuation::Attenuation_72};
+};
+
+inline bool operator==(const CutShape& a, const CutShape& b)
+{
+    return a.family == b.family && a.transition == b.transition && a.attenuation == b.attenuation;
+}
+
+inline bool operator!=(const CutShape& a, const CutShape& b)
+{
+    return ! (a == b);
+}
+
+struct ChainSettings
+{
+    BandArray bands;
+    float lowCutFreq{0}, highCutFreq{0};
+    Slope lowCutSlope{Slope::Slope_12}, highCutSlope{Slope::Slope_12};
+    CutShape lowCutShape, highCutShape;
+    bool lowCutBypassed {false}, highCutBypassed {false};
+    FilterTopology topology {FilterTopology::Biquad};
+    ChannelMode channelMode {ChannelMode::StereoLinked};
+};
+
+inline bool operator==(const ChainSettings& a, const ChainSettings& b)
+{
+    return a.bands == b.bands
+        && a.lowCutFreq == b.lowCutFreq && a.highCutFreq == b.highCutFreq
+        && a.lowCutSlope == b.lowCutSlope && a.highCutSlope == b.highCutSlope
+        && a.lowCutShape == b.lowCutShape && a.highCutShape == b.highCutShape
+        && a.lowCutBypassed == b.lowCutBypassed && a.highCutBypassed == b.highCutBypassed
+        && a.topology == b.topology && a.channelMode == b.channelMode;
+}
+
+using Coefficients = Filter::CoefficientsPtr;
+void updateCoefficients(Coefficients& old, const Coefficients& replacements);
+
+Coefficients makeBandFilter(const BandSettings& band, double sampleRate);
+
+//one set of coefficients per section in use, the remaining sections are bypassed
+template<typename ChainType, typename CoefficientType>
+void updateCutFilter(ChainType& chain, const CoefficientType& coefficients)
+{
+    const auto numSections = (size_t) coefficients.size();
+    
+    forEachSection(chain, [&chain, &coefficients, numSections](auto& section, auto index)
+    {
+        const bool used = index < numSections;
+        if( used )
+            updateCoefficients(section.coefficients, coefficients[(int) index]);
+        chain.template setBypassed<decltype(index)::value>(! used);
+    });
+}
+
+using CutCoefficients = juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>>;
+
+CutCoefficients makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate);
+CutCoefficients makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate);
+
+//==============================================================================
+//Allocation-free designers for the audio thread. They rewrite the coefficients of
+//an existing biquad in place, with the same formulas as IIR::Coefficients, or
+//retune an SvfFilter.
+void designBand(Filter& filter, const BandSettings& band, double sampleRate);
+void designBand(SvfFilter& filter, const BandSettings& band, double sampleRate);
+
+//1/Q of each second-order section of a Butterworth cut with the given slope
+inline const std::array<float, maxCutSections>& getButterworthInverseQs(const Slope& slope)
+{
+    static const auto table = []
+    {
+        std::array<std::array<float, maxCutSections>, maxCutSections> inverseQs {};
+        for( int s = Slope_12; s <= Slope_96; ++s )
+        {
+            const int order = (s + 1) * 2;
+            for( int i = 0; i <= s; ++i )
+                inverseQs[s][i] = 2.0f * (float) std::cos((2 * i + 1) * juce::MathConstants<double>::pi / (2 * order));
+        }
+        return inverseQs;
+    }();
+    
+    return table[slope];
+}
+
+//what all the sections of one Butterworth cut have in common
+struct CutDesign
+{
+    float normalisedFrequency, n;
+    bool highPass;
+};
+
+inline void designCutSection(float* c, const CutDesign& design, float inverseQ)
+{
+    const auto n = design.n;
+    const auto nSquared = n * n;
+    const auto c1 = 1.0f / (1.0f + inverseQ * n + nSquared);
+    
+    c[0] = c1;
+    c[1] = design.highPass ? -2.0f * c1 : 2.0f * c1;
+    c[2] = c1;
+    c[3] = design.highPass ? 2.0f * c1 * (nSquared - 1.0f) : 2.0f * c1 * (1.0f - nSquared);
+    c[4] = c1 * (1.0f - inverseQ * n + nSquared);
+}
+
+inline void designCutSection(Filter& filter, const CutDesign& design, float inverseQ)
+{
+    jassert(filter.coefficients->getFilterOrder() == 2);
+    designCutSection(filter.coefficients->getRawCoefficients(), design, inverseQ);
+}
+
+//the allpass with the poles of a lowpass section: its numerator is the denominator reversed
+inline void designAllPassSection(float* c, const CutDesign& design, float inverseQ)
+{
+    jassert(! design.highPass);
+    
+    const auto n = design.n;
+    const auto nSquared = n * n;
+    const auto c1 = 1.0f / (1.0f + inverseQ * n + nSquared);
+    
+    c[0] = c[4] = c1 * (1.0f - inverseQ * n + nSquared);
+    c[1] = c[3] = 2.0f * c1 * (1.0f - nSquared);
+    c[2] = 1.0f;
+}
+
+inline void designCutSection(SvfFilter& filter, const CutDesign& design, float inverseQ)
+{
+    if( design.highPass )
+        filter.parameters->setHighPass(design.normalisedFrequency, inverseQ);
+    else
+        filter.parameters->setLowPass(design.normalisedFrequency, inverseQ);
+}
+
+//designs a Butterworth cut, returns the number of sections in use
+template<typename ChainType>
+size_t designCutFilter(ChainType& chain, float frequency, const Slope& slope, bool highPass, double sampleRate)
+{
+    //a single tan() is shared by every biquad section of the cascade
+    const auto normalisedFrequency = frequency / (float) sampleRate;
+    const auto t = std::tan(juce::MathConstants<float>::pi * normalisedFrequency);
+    const CutDesign design { normalisedFrequency, highPass ? t : 1.0f / t, highPass };
+    
+    const auto& inverseQs = getButterworthInverseQs(slope);
+    const auto numSections = getNumSections(slope);
+    
+    forEachSection(chain, [&design, &inverseQs, numSections](auto& section, auto index)
+    {
+        if( index < numSections )
+            designCutSection(section, design, inverseQs[index]);
+    });
+    
+    return numSections;
+}
+
+/*
+ Chebyshev and elliptic cuts are lowpass prototypes designed once, with JUCE's
+ high-order methods, with their passband edge at a quarter of the sample rate.
+ A cut at any other frequency, lowpass or highpass, is an allpass substitution
+ of z^-1 in each section (Constantinides): a few multiplies per section and no
+ allocation, so it runs on the audio thread like the Butterworth designer.
+ */
+struct CutPrototype
+{
+    //b0, b1, b2, a1, a2 of each section, normalised by a0; first-order sections have b2 = a2 = 0
+    using Section = std::array<double, 5>;
+    
+    std::array<Section, maxCutSections> sections {};
+    size_t numSections = 0;
+};
+
+//the whole table is designed on the first call, prepareToPlay makes sure that is not the audio thread
+const CutPrototype& getCutPrototype(const CutShape& shape);
+
+//alpha of the substitution that moves the prototype's band edge to the given frequency
+inline double getCutTransformAlpha(float frequency, bool highPass, double sampleRate)
+{
+    const auto halfPi = juce::MathConstants<double>::halfPi;
+    const auto cutoff = juce::MathConstants<double>::twoPi * juce::jlimit(1.0, 0.49 * sampleRate, (double) frequency) / sampleRate;
+    
+    //lowpass: z^-1 -> (z^-1 - alpha) / (1 - alpha z^-1), highpass: z^-1 -> -(z^-1 + alpha) / (1 + alpha z^-1)
+    return highPass ? -std::cos((halfPi + cutoff) / 2.0) / std::cos((halfPi - cutoff) / 2.0)
+                    : std::sin((halfPi - cutoff) / 2.0) / std::sin((halfPi + cutoff) / 2.0);
+}
+
+//writes b0, b1, b2, a1, a2 of the transformed section to 'coefficients'
+inline void transformCutSection(const CutPrototype::Section& section, double alpha, bool highPass, float* coefficients)
+{
+    const auto alphaSquared = alpha * alpha;
+    const auto sign = highPass ? -1.0 : 1.0;
+    
+    auto transform = [alpha, alphaSquared, sign](double p0, double p1, double p2, double* result)
+    {
+        result[0] = p0 - alpha * p1 + alphaSquared * p2;
+        result[1] = sign * ((1.0 + alphaSquared) * p1 - 2.0 * alpha * (p0 + p2));
+        result[2] = alphaSquared * p0 - alpha * p1 + p2;
+    };
+    
+    double b[3], a[3];
+    transform(section[0], section[1], section[2], b);
+    transform(1.0, section[3], section[4], a);
+    
+    const auto a0Inverse = 1.0 / a[0];
+    coefficients[0] = (float) (b[0] * a0Inverse);
+    coefficients[1] = (float) (b[1] * a0Inverse);
+    coefficients[2] = (float) (b[2] * a0Inverse);
+    coefficients[3] = (float) (a[1] * a0Inverse);
+    coefficients[4] = (float) (a[2] * a0Inverse);
+}
+
+inline void designCutSection(Filter& filter, const CutPrototype::Section& section, double alpha, bool highPass)
+{
+    jassert(filter.coefficients->getFilterOrder() == 2);
+    transformCutSection(section, alpha, highPass, filter.coefficients->getRawCoefficients());
+}
+
+//only biquad sections take the prototype designs, state-variable cuts stay Butterworth
+template<typename SectionType>
+struct TakesCutPrototypes : std::false_type {};
+
+template<>
+struct TakesCutPrototypes<Filter> : std::true_type {};
+
+template<typename ChainType>
+size_t designPrototypeCut(ChainType& chain, float frequency, const CutPrototype& prototype, bool highPass, double sampleRate, std::true_type)
+{
+    const auto alpha = getCutTransformAlpha(frequency, highPass, sampleRate);
+    const auto numSections = prototype.numSections;
+    
+    forEachSection(chain, [&prototype, alpha, highPass, numSections](auto& section, auto index)
+    {
+        if( index < numSections )
+            designCutSection(section, prototype.sections[index], alpha, highPass);
+    });
+    
+    return numSections;
+}
+
+template<typename ChainType>
+size_t designPrototypeCut(ChainType&, float, const CutPrototype&, bool, double, std::false_type)
+{
+    jassertfalse;
+    return 0;
+}
+
+//designs a cut of any family, returns the number of sections in use
+template<typename ChainType>
+size_t designCutFilter(ChainType& chain, float frequency, const Slope& slope, const CutShape& shape, bool highPass, double sampleRate)
+{
+    using TakesPrototypes = TakesCutPrototypes<typename std::decay<decltype(chain.template get<0>())>::type>;
+    
+    if( shape.family == CutFamily::Butterworth || ! TakesPrototypes::value )
+        return designCutFilter(chain, frequency, slope, highPass, sampleRate);
+    
+    return designPrototypeCut(chain, frequency, getCutPrototype(shape), highPass, sampleRate, TakesPrototypes());
+}
+
+//unused sections are bypassed, and cost nothing
+template<typename ChainType>
+void setActiveSections(ChainType& chain, size_t numSections)
+{
+    forEachSection(chain, [&chain, numSections](auto&, auto index)
+    {
+        chain.template setBypassed<decltype(index)::value>(index >= numSections);
+    });
+}
+
+template<typename ChainType>
+void setCutFilterSlope(ChainType& chain, const Slope& slope)
+{
+    setActiveSections(chain, getNumSections(slope));
+}
+
+//==============================================================================
+//Settings part way from 'from' (amount 0) to 'to' (amount 1), in the units the ear hears:
+//frequencies and Q along a log scale, gains in dB. Anything that cannot be in between
+//(slopes, shapes, band types, channels, modes) comes from the nearer snapshot. A band
+//enabled in only one snapshot fades in from 0 dB instead of switching on at full gain.
+ChainSettings morphChainSettings(const ChainSettings& from, const ChainSettings& to, float amount);
+
+//==============================================================================
+//The response of a whole chain, for drawing it and for the linear-phase FIR: by default with
+//every band, or with the bands of one path (0 or 1) of the chainSettings' channel mode.
+//setChainResponse allocates, so it is not for the audio thread.
+void setChainResponse(MonoChain& chain, ChainSettings chainSettings, double sampleRate, int channel = -1);
+double getChainMagnitude(const MonoChain& chain, double frequency, double sampleRate);
+
+//Linear-phase mode replaces the IIR chains with a symmetric FIR of the chain's magnitude
+//response, run by juce::dsp::Convolution. Longer FIRs resolve the low end better but cost
+//latency; the convolution's partition size trades latency for CPU on top of that.
+enum LinearPhaseQuality
+{
+    LinearPhaseOff,
+    LinearPhaseLow,
+    LinearPhaseMedium,
+    LinearPhaseHigh
+};
+
+struct LinearPhasePreset
+{
+    int firOrder;       //the FIR has 2^firOrder - 1 taps, centred on the middle one
+    int partitionSize;  //uniform partitions of the convolution, added to the latency
+};
+
+inline LinearPhasePreset getLinearPhasePreset(LinearPhaseQuality quality)
+{
+    switch( quality )
+    {
+        case LinearPhaseLow:    return { 12, 256 };
+        case LinearPhaseMedium: return { 14, 1024 };
+        case LinearPhaseHigh:   return { 16, 4096 };
+        case LinearPhaseOff:
+        default:                return { 0, 0 };
+    }
+}
+
+//a windowed, zero-phase FIR of the chain's magnitude response, delayed to its middle tap
+juce::AudioBuffer<float> designLinearPhaseFir(const MonoChain& chain, int firOrder, double sampleRate);
+
+//Linkwitz-Riley splits from the Butterworth cut design: each lowpass and highpass is the
+//12 dB/oct (LR4) or 24 dB/oct (LR8) Butterworth cascade run twice. Cheap enough for the audio thread.
+void designCrossover(LinkwitzRileyCrossover& crossover, const CrossoverSettings& settings, double sampleRate);
+
+//==============================================================================
+//both channels always run the same filters, so every stage of the right chain
+//shares its response with the left one and each update is designed once
+inline void shareResponse(Filter& left, Filter& right)
+{
+    left.coefficients = new juce::dsp::IIR::Coefficients<float>(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+    right.coefficients = left.coefficients;
+}
+
+inline void shareResponse(SvfFilter& left, SvfFilter& right)
+{
+    left.parameters = new SvfParameters();
+    right.parameters = left.parameters;
+}
+
+template<typename CutType>
+void shareCutResponses(CutType& left, CutType& right)
+{
+    forEachSection(left, [&right](auto& section, auto index)
+    {
+        shareResponse(section, right.template get<decltype(index)::value>());
+    });
+}
+
+template<typename SectionType>
+void shareBandResponses(ParametricBands<SectionType>& left, ParametricBands<SectionType>& right)
+{
+    for( size_t i = 0; i < maxBands; ++i )
+        shareResponse(left.getBand(i), right.getBand(i));
+}
+
+template<typename ChainType>
+void shareResponses(ChainType& left, ChainType& right)
+{
+    shareCutResponses(left.template get<ChainPositions::LowCut>(), right.template get<ChainPositions::LowCut>());
+    shareBandResponses(left.template get<ChainPositions::Bands>(), right.template get<ChainPositions::Bands>());
+    shareCutResponses(left.template get<ChainPositions::HighCut>(), right.template get<ChainPositions::HighCut>());
+}
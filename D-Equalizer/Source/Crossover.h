@@ -0,0 +1,202 @@
+/*
+  ==============================================================================
+
+    Crossover.h
+    Linkwitz-Riley multiband split: 2 to 5 bands, each with its own gain, mute
+    and solo, summed back together after the EQ.
+
+    The split is a tree. The signal is split at the lowest crossover, the high
+    side of that split is split again at the next one, and so on, so every
+    split filters what the previous one left instead of the whole input: N
+    bands cost N - 1 lowpass/highpass pairs, against the 2 (N - 1) filters of
+    separate band-passes. Each band below the top one also runs the allpass of
+    every crossover above its own (the sum of that crossover's lowpass and
+    highpass), so all bands leave with the same phase and sum back flat.
+    A band that is muted, or silenced by a solo, is not filtered at all.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+#include <algorithm>
+#include <array>
+
+constexpr size_t maxCrossoverBands = 5;
+
+struct CrossoverSettings
+{
+    size_t numBands {1};    //a single band switches the crossover off
+    bool steep {false};     //LR8 instead of LR4
+    std::array<float, maxCrossoverBands - 1> frequencies {{ 120.0f, 500.0f, 2000.0f, 6000.0f }};
+    std::array<float, maxCrossoverBands> gainDb {};
+    std::array<bool, maxCrossoverBands> muted {}, soloed {};
+};
+
+inline bool operator==(const CrossoverSettings& a, const CrossoverSettings& b)
+{
+    return a.numBands == b.numBands && a.steep == b.steep && a.frequencies == b.frequencies
+        && a.gainDb == b.gainDb && a.muted == b.muted && a.soloed == b.soloed;
+}
+
+class LinkwitzRileyCrossover
+{
+public:
+    //sections of one Butterworth cascade; each Linkwitz-Riley filter runs its cascade twice
+    static constexpr size_t maxSections = 2;
+
+    //b0, b1, b2, a1, a2, normalised by a0
+    using Section = std::array<float, 5>;
+
+    struct Split
+    {
+        std::array<Section, maxSections> lowPass {}, highPass {}, allPass {};
+    };
+
+    Split& getSplit(size_t index) { return splits[index]; }
+
+    //a new band count or order starts the filters from silence
+    void setLayout(size_t newNumBands, size_t newNumSections)
+    {
+        if( newNumBands == numBands && newNumSections == numSections )
+            return;
+
+        numBands = newNumBands;
+        numSections = newNumSections;
+        reset();
+    }
+
+    //linear band gains, mute and solo already applied; they glide there across the next block
+    void setBandGains(const std::array<float, maxCrossoverBands>& newGains) { targetGains = newGains; }
+
+    void prepare(int maxBlockSize)
+    {
+        restBuffer.setSize(1, maxBlockSize);
+        bandBuffer.setSize(1, maxBlockSize);
+        gains = targetGains;
+        reset();
+    }
+
+    void reset()
+    {
+        for( auto& channel : channels )
+            channel = ChannelState();
+    }
+
+    //processes the first two channels in place; a block longer than prepare() was told goes
+    //through in pieces of that size, the scratch buffers hold no more
+    void process(juce::dsp::AudioBlock<float>& block) noexcept
+    {
+        const auto numSamples = (int) block.getNumSamples();
+        const auto maxChunk = restBuffer.getNumSamples();
+        jassert(maxChunk > 0);
+
+        for( int start = 0; maxChunk > 0 && start < numSamples; start += maxChunk )
+        {
+            const auto length = juce::jmin(maxChunk, numSamples - start);
+
+            for( size_t ch = 0; ch < juce::jmin(channels.size(), block.getNumChannels()); ++ch )
+                processChannel(block.getChannelPointer(ch) + start, length, channels[ch]);
+
+            gains = targetGains;
+        }
+    }
+
+private:
+    using State = std::array<float, 2>;
+
+    struct ChannelState
+    {
+        //both passes of each split's cascades
+        std::array<std::array<State, 2 * maxSections>, maxCrossoverBands - 1> lowPass {}, highPass {};
+        //allPass[band][split]: the allpass of a split above the band
+        std::array<std::array<std::array<State, maxSections>, maxCrossoverBands - 1>, maxCrossoverBands - 1> allPass {};
+        std::array<bool, maxCrossoverBands> idle {};
+    };
+
+    static void processSection(const Section& c, State& state, float* samples, int numSamples) noexcept
+    {
+        auto s1 = state[0], s2 = state[1];
+
+        for( int i = 0; i < numSamples; ++i )
+        {
+            //transposed direct form II
+            const auto input = samples[i];
+            const auto output = c[0] * input + s1;
+            s1 = c[1] * input - c[3] * output + s2;
+            s2 = c[2] * input - c[4] * output;
+            samples[i] = output;
+        }
+
+        juce::dsp::util::snapToZero(s1);
+        juce::dsp::util::snapToZero(s2);
+        state = { s1, s2 };
+    }
+
+    void processCascade(const std::array<Section, maxSections>& sections, State* states, float* samples, int numSamples) const noexcept
+    {
+        for( size_t s = 0; s < numSections; ++s )
+            processSection(sections[s], states[s], samples, numSamples);
+    }
+
+    void addBand(float* output, const float* band, int numSamples, size_t index) const noexcept
+    {
+        const auto start = gains[index];
+        const auto step = (targetGains[index] - start) / (float) numSamples;
+
+        for( int i = 0; i < numSamples; ++i )
+            output[i] += (start + step * (float) (i + 1)) * band[i];
+    }
+
+    void processChannel(float* samples, int numSamples, ChannelState& state) noexcept
+    {
+        auto* rest = restBuffer.getWritePointer(0);
+        auto* band = bandBuffer.getWritePointer(0);
+
+        std::copy(samples, samples + numSamples, rest);
+        std::fill(samples, samples + numSamples, 0.0f);
+
+        for( size_t k = 0; k + 1 < numBands; ++k )
+        {
+            const auto& split = splits[k];
+
+            if( gains[k] != 0.0f || targetGains[k] != 0.0f )
+            {
+                //a band that was silent comes back from cleared state
+                if( state.idle[k] )
+                {
+                    state.lowPass[k] = {};
+                    state.allPass[k] = {};
+                    state.idle[k] = false;
+                }
+
+                std::copy(rest, rest + numSamples, band);
+                processCascade(split.lowPass, state.lowPass[k].data(), band, numSamples);
+                processCascade(split.lowPass, state.lowPass[k].data() + maxSections, band, numSamples);
+
+                for( size_t j = k + 1; j + 1 < numBands; ++j )
+                    processCascade(splits[j].allPass, state.allPass[k][j].data(), band, numSamples);
+
+                addBand(samples, band, numSamples, k);
+            }
+            else
+            {
+                state.idle[k] = true;
+            }
+
+            processCascade(split.highPass, state.highPass[k].data(), rest, numSamples);
+            processCascade(split.highPass, state.highPass[k].data() + maxSections, rest, numSamples);
+        }
+
+        addBand(samples, rest, numSamples, numBands - 1);
+    }
+
+    std::array<Split, maxCrossoverBands - 1> splits;
+    std::array<ChannelState, 2> channels;
+    std::array<float, maxCrossoverBands> gains {}, targetGains {};
+    size_t numBands = 1, numSections = 1;
+
+    juce::AudioBuffer<float> restBuffer, bandBuffer;
+};
@@ -0,0 +1,461 @@
+/*
+  ==============================================================================
+
+    EQEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "EQEngine.h"
+
+void encodeMidSide(const juce::dsp::AudioBlock<float>& input, juce::dsp::AudioBlock<float>& output)
+{
+    const auto* left = input.getChannelPointer(0);
+    const auto* right = input.getChannelPointer(1);
+    auto* mid = output.getChannelPointer(0);
+    auto* side = output.getChannelPointer(1);
+    
+    for (size_t i = 0; i < output.getNumSamples(); ++i) {
+        const auto l = left[i], r = right[i];
+        mid[i] = 0.5f * (l + r);
+        side[i] = 0.5f * (l - r);
+    }
+}
+
+void decodeMidSide(juce::dsp::AudioBlock<float>& block)
+{
+    auto* first = block.getChannelPointer(0);
+    auto* second = block.getChannelPointer(1);
+    
+    for (size_t i = 0; i < block.getNumSamples(); ++i) {
+        const auto mid = first[i], side = second[i];
+        first[i] = mid + side;
+        second[i] = mid - side;
+    }
+}
+
+//==============================================================================
+void EQEngine::prepare(double newSampleRate, int maximumBlockSize, int newNumChannels)
+{
+    jassert(newNumChannels == 1 || newNumChannels == 2);
+    
+    sampleRate = newSampleRate;
+    numChannels = juce::jlimit(1, 2, newNumChannels);
+    
+    juce::dsp::ProcessSpec spec;
+    spec.maximumBlockSize = (juce::uint32) maximumBlockSize;
+    spec.numChannels = 1;
+    spec.sampleRate = sampleRate;
+    
+    for (size_t i = 0; i < leftChains.size(); ++i) {
+        shareResponses(leftChains[i], rightChains[i]);
+        shareResponses(leftSvfChains[i], rightSvfChains[i]);
+    }
+    
+    //the cut prototypes are designed here rather than on the audio thread
+    getCutPrototype({ CutFamily::Elliptic });
+    
+    const auto& chainSettings = targetSettings;
+    smoothedSettings.reset(sampleRate, smoothingTimeSeconds);
+    smoothedSettings.setCurrentAndTargetValues(chainSettings);
+    snapSmoothing.set(false);
+    designedSettings = chainSettings;
+    
+    samplePosition = 0;
+    
+    //both topologies start tuned, only the selected one runs
+    chainTopologies.fill(chainSettings.topology);
+    chainModes.fill(chainSettings.channelMode);
+    currentChains = 0;
+    updateFilters(leftChains[currentChains], rightChains[currentChains], chainSettings);
+    updateFilters(leftSvfChains[currentChains], rightSvfChains[currentChains], chainSettings);
+    
+    for (auto* chain : { &leftChains[0], &leftChains[1], &rightChains[0], &rightChains[1] })
+        chain->prepare(spec);
+    for (auto* chain : { &leftSvfChains[0], &leftSvfChains[1], &rightSvfChains[0], &rightSvfChains[1] })
+        chain->prepare(spec);
+    
+    transitionBuffer.setSize(2, maximumBlockSize);
+    transitionLength = juce::jmax(1, juce::roundToInt(sampleRate * slopeTransitionSeconds));
+    transitionSamplesRemaining = 0;
+    
+    dryBuffer.setSize(1, maximumBlockSize);
+    detectorBuffer.setSize(1, maximumBlockSize);
+    dynamics.prepare(sampleRate);
+    dynamics.setBands(chainSettings.bands);
+    const auto bypassRampLength = juce::jmax(1, juce::roundToInt(sampleRate * bypassRampSeconds));
+    stageBypass[ChainPositions::LowCut].reset(chainSettings.lowCutBypassed, bypassRampLength);
+    stageBypass[ChainPositions::Bands].reset(allBandsBypassed(chainSettings.bands), bypassRampLength);
+    stageBypass[ChainPositions::HighCut].reset(chainSettings.highCutBypassed, bypassRampLength);
+}
+
+void EQEngine::reset()
+{
+    //they start from silence and jump to the current settings
+    for (auto* chain : { &leftChains[0], &leftChains[1], &rightChains[0], &rightChains[1] })
+        chain->reset();
+    for (auto* chain : { &leftSvfChains[0], &leftSvfChains[1], &rightSvfChains[0], &rightSvfChains[1] })
+        chain->reset();
+    
+    snapSmoothing.set(true);
+}
+
+void EQEngine::process(float* const* channels, int numSamples)
+{
+    juce::dsp::AudioBlock<float> block (channels, (size_t) numChannels, (size_t) numSamples);
+    process(block, juce::AudioBuffer<float>());
+}
+
+void EQEngine::updateSettingsAt(juce::int64 position)
+{
+    if (gridListener != nullptr)
+        gridListener->gridPointReached(position);
+    
+    auto chainSettings = targetSettings;
+    
+    //a topology, slope, shape or band layout change waits until the running transition is over
+    if (transitionSamplesRemaining > 0) {
+        chainSettings.topology = designedSettings.topology;
+        chainSettings.lowCutSlope = designedSettings.lowCutSlope;
+        chainSettings.highCutSlope = designedSettings.highCutSlope;
+        chainSettings.lowCutShape = designedSettings.lowCutShape;
+        chainSettings.highCutShape = designedSettings.highCutShape;
+        chainSettings.channelMode = designedSettings.channelMode;
+        
+        for (size_t i = 0; i < maxBands; ++i) {
+            chainSettings.bands[i].bypassed = designedSettings.bands[i].bypassed;
+            chainSettings.bands[i].type = designedSettings.bands[i].type;
+            chainSettings.bands[i].channel = designedSettings.bands[i].channel;
+        }
+    }
+    
+    //a freshly loaded state jumps to its values instead of gliding there
+    if (snapSmoothing.compareAndSetBool(false, true))
+        smoothedSettings.setCurrentAndTargetValues(chainSettings);
+    else
+        smoothedSettings.setTargetValues(chainSettings);
+    
+    if (smoothedSettings.isSmoothing()) {
+        smoothedSettings.skip(smoothingSubBlockSize);
+    } else if (chainSettings == designedSettings) {
+        //nothing was changed, but dynamic bands keep following their detectors
+        if (dynamics.getNumActive() > 0)
+            updateDynamicBands(smoothedSettings.applyTo(chainSettings));
+        return;
+    }
+    
+    const auto topologyChanged = chainSettings.topology != designedSettings.topology;
+    //a new family, width or attenuation changes the sections just like a new slope does,
+    //and so does adding, removing, retyping or moving a band, or a new channel mode
+    const auto slopeChanged = chainSettings.channelMode != designedSettings.channelMode
+                           || chainSettings.lowCutSlope != designedSettings.lowCutSlope
+                           || chainSettings.highCutSlope != designedSettings.highCutSlope
+                           || chainSettings.lowCutShape != designedSettings.lowCutShape
+                           || chainSettings.highCutShape != designedSettings.highCutShape
+                           || ! haveSameLayout(chainSettings.bands, designedSettings.bands);
+    
+    designedSettings = chainSettings;
+    
+    //the spare slot picks up the new topology or slopes from silence and is faded in over the old one
+    if (topologyChanged || slopeChanged) {
+        currentChains = 1 - currentChains;
+        transitionSamplesRemaining = transitionLength;
+    }
+    
+    chainTopologies[(size_t) currentChains] = chainSettings.topology;
+    chainModes[(size_t) currentChains] = chainSettings.channelMode;
+    
+    //bypass fades a stage out instead of switching it off; a stage that comes back
+    //after being silent starts from cleared state, so it is reset here
+    StageFlags stagesToReset;
+    stagesToReset[ChainPositions::LowCut] = stageBypass[ChainPositions::LowCut].setBypassed(chainSettings.lowCutBypassed);
+    stagesToReset[ChainPositions::Bands] = stageBypass[ChainPositions::Bands].setBypassed(allBandsBypassed(chainSettings.bands));
+    stagesToReset[ChainPositions::HighCut] = stageBypass[ChainPositions::HighCut].setBypassed(chainSettings.highCutBypassed);
+    
+    if (topologyChanged || slopeChanged)
+        stagesToReset.fill(true);
+    
+    auto currentSettings = smoothedSettings.applyTo(chainSettings);
+    
+    dynamics.setBands(currentSettings.bands);
+    dynamics.applyTo(currentSettings.bands);
+    
+    if (chainSettings.topology == FilterTopology::StateVariable)
+        updateCurrentChains(leftSvfChains, rightSvfChains, currentSettings, stagesToReset);
+    else
+        updateCurrentChains(leftChains, rightChains, currentSettings, stagesToReset);
+}
+
+void EQEngine::updateDynamicBands(const ChainSettings& chainSettings)
+{
+    auto bands = chainSettings.bands;
+    dynamics.applyTo(bands);
+    
+    //the right chains share the left ones' coefficients
+    if (chainTopologies[(size_t) currentChains] == FilterTopology::StateVariable)
+        designDynamicBands(leftSvfChains[(size_t) currentChains], bands);
+    else
+        designDynamicBands(leftChains[(size_t) currentChains], bands);
+}
+
+template<typename ChainType>
+void EQEngine::designDynamicBands(ChainType& chain, const BandArray& bands)
+{
+    auto& stage = chain.template get<ChainPositions::Bands>();
+    
+    for (size_t a = 0; a < dynamics.getNumActive(); ++a) {
+        const auto band = dynamics.getActiveBand(a);
+        designBand(stage.getBand(band), bands[band], sampleRate);
+    }
+}
+
+template<typename ChainArray>
+void EQEngine::updateCurrentChains(ChainArray& left, ChainArray& right, const ChainSettings& chainSettings, const StageFlags& stagesToReset)
+{
+    auto& leftChain = left[(size_t) currentChains];
+    auto& rightChain = right[(size_t) currentChains];
+    
+    updateFilters(leftChain, rightChain, chainSettings);
+    
+    if (stagesToReset[ChainPositions::LowCut]) {
+        leftChain.template get<ChainPositions::LowCut>().reset();
+        rightChain.template get<ChainPositions::LowCut>().reset();
+    }
+    
+    if (stagesToReset[ChainPositions::Bands]) {
+        leftChain.template get<ChainPositions::Bands>().reset();
+        rightChain.template get<ChainPositions::Bands>().reset();
+    }
+    
+    if (stagesToReset[ChainPositions::HighCut]) {
+        leftChain.template get<ChainPositions::HighCut>().reset();
+        rightChain.template get<ChainPositions::HighCut>().reset();
+    }
+}
+
+void EQEngine::runDetectors(const juce::dsp::AudioBlock<float>& block, const juce::AudioBuffer<float>& sidechain, int sidechainOrder, int start, int numSamples)
+{
+    auto* detectorInput = detectorBuffer.getWritePointer(0);
+    
+    //The mono sum of the sidechain, or of the input before it is filtered. The sidechain
+    //may run at a lower rate: when oversampling, each of its samples is held for the factor.
+    if (sidechain.getNumChannels() > 0) {
+        const auto* first = sidechain.getReadPointer(0);
+        const auto* second = sidechain.getReadPointer(juce::jmin(1, sidechain.getNumChannels() - 1));
+        
+        for (int i = 0; i < numSamples; ++i) {
+            const auto hostSample = (start + i) >> sidechainOrder;
+            detectorInput[i] = 0.5f * (first[hostSample] + second[hostSample]);
+        }
+    } else {
+        const auto* first = block.getChannelPointer(0) + start;
+        const auto* second = block.getChannelPointer(block.getNumChannels() - 1) + start;
+        
+        for (int i = 0; i < numSamples; ++i)
+            detectorInput[i] = 0.5f * (first[i] + second[i]);
+    }
+    
+    dynamics.process(detectorInput, numSamples);
+}
+
+void EQEngine::process(juce::dsp::AudioBlock<float>& block, const juce::AudioBuffer<float>& sidechain, int sidechainOrder)
+{
+    jassert(block.getNumChannels() >= (size_t) numChannels);
+    
+    auto engineBlock = block.getSubsetChannelBlock(0, (size_t) numChannels);
+    const auto numSamples = (int) block.getNumSamples();
+    bool settingsChecked = false;
+    
+    //Settings only change on grid points, never on the host's block boundaries. Between
+    //grid points a block is processed in one go unless a parameter is gliding.
+    for (int start = 0; start < numSamples;) {
+        const auto position = samplePosition + start;
+        const auto offsetInCell = (int) (position % smoothingSubBlockSize);
+        
+        if (offsetInCell == 0) {
+            updateSettingsAt(position);
+            settingsChecked = true;
+        }
+        
+        const auto nextGridPoint = position + smoothingSubBlockSize - offsetInCell;
+        auto end = samplePosition + numSamples;
+        
+        if (! settingsChecked || smoothedSettings.isSmoothing() || dynamics.getNumActive() > 0) {
+            end = juce::jmin(end, nextGridPoint);
+        } else if (gridListener != nullptr && gridListener->getNextChangePosition() >= 0) {
+            const auto changePosition = gridListener->getNextChangePosition();
+            const auto changeGridPoint = (changePosition + smoothingSubBlockSize - 1) / smoothingSubBlockSize * smoothingSubBlockSize;
+            end = juce::jmin(end, juce::jmax(nextGridPoint, changeGridPoint));
+        }
+        
+        //never more than the prepared block size, the scratch buffers hold that much
+        end = juce::jmin(end, position + dryBuffer.getNumSamples());
+        
+        const auto length = (int) (end - position);
+        auto segment = engineBlock.getSubBlock((size_t) start, (size_t) length);
+        
+        //the detectors hear this segment before it is filtered, the gains follow on the next grid point
+        if (dynamics.getNumActive() > 0)
+            runDetectors(engineBlock, sidechain, sidechainOrder, start, length);
+        
+        processChains(segment);
+        
+        start += length;
+    }
+    
+    samplePosition += numSamples;
+}
+
+void EQEngine::processChains(juce::dsp::AudioBlock<float>& block)
+{
+    const auto numSamples = (int) block.getNumSamples();
+    const auto stereo = block.getNumChannels() > 1;
+    const auto inTransition = transitionSamplesRemaining > 0;
+    
+    //slope transition: the outgoing chains run on a copy of the input and are faded out
+    auto oldBlock = juce::dsp::AudioBlock<float>(transitionBuffer).getSubsetChannelBlock(0, block.getNumChannels())
+                                                                  .getSubBlock(0, (size_t) numSamples);
+    
+    //mid/side chains encode on the way in and decode on the way out; for the outgoing
+    //chains the encoder doubles as the copy. A mono engine only runs the left chains.
+    if (inTransition) {
+        const auto oldMidSide = stereo && chainModes[(size_t) (1 - currentChains)] == ChannelMode::MidSide;
+        
+        if (oldMidSide)
+            encodeMidSide(block, oldBlock);
+        else
+            oldBlock.copyFrom(block);
+        
+        processSlot(1 - currentChains, oldBlock);
+        
+        if (oldMidSide)
+            decodeMidSide(oldBlock);
+    }
+    
+    const auto midSide = stereo && chainModes[(size_t) currentChains] == ChannelMode::MidSide;
+    
+    if (midSide)
+        encodeMidSide(block, block);
+    
+    processSlot(currentChains, block);
+    
+    if (midSide)
+        decodeMidSide(block);
+    
+    if (inTransition) {
+        const auto fadeLength = juce::jmin(numSamples, transitionSamplesRemaining);
+        
+        for (size_t ch = 0; ch < block.getNumChannels(); ++ch) {
+            auto* output = block.getChannelPointer(ch);
+            const auto* old = oldBlock.getChannelPointer(ch);
+            
+            for (int i = 0; i < fadeLength; ++i) {
+                const auto oldGain = (float) (transitionSamplesRemaining - i - 1) / (float) transitionLength;
+                output[i] += oldGain * (old[i] - output[i]);
+            }
+        }
+        
+        transitionSamplesRemaining -= fadeLength;
+    }
+    
+    for (auto& bypass : stageBypass)
+        bypass.advance(numSamples);
+}
+
+void EQEngine::processSlot(int slot, juce::dsp::AudioBlock<float>& block)
+{
+    if (chainTopologies[(size_t) slot] == FilterTopology::StateVariable)
+        processPair(leftSvfChains[(size_t) slot], rightSvfChains[(size_t) slot], block);
+    else
+        processPair(leftChains[(size_t) slot], rightChains[(size_t) slot], block);
+}
+
+template<typename ChainType>
+void EQEngine::processPair(ChainType& left, ChainType& right, juce::dsp::AudioBlock<float>& block)
+{
+    processStages(left, block.getSingleChannelBlock(0));
+    if (block.getNumChannels() > 1)
+        processStages(right, block.getSingleChannelBlock(1));
+}
+
+template<typename ChainType>
+void EQEngine::processStages(ChainType& chain, juce::dsp::AudioBlock<float> block)
+{
+    processStage<ChainPositions::LowCut>(chain, block);
+    processStage<ChainPositions::Bands>(chain, block);
+    processStage<ChainPositions::HighCut>(chain, block);
+}
+
+template<int Position, typename ChainType>
+void EQEngine::processStage(ChainType& chain, juce::dsp::AudioBlock<float>& block)
+{
+    const auto& bypass = stageBypass[Position];
+    
+    //a bypassed stage costs nothing once its fade-out is over
+    if (bypass.isOff())
+        return;
+    
+    auto& stage = chain.template get<Position>();
+    juce::dsp::ProcessContextReplacing<float> context (block);
+    
+    if (! bypass.isRamping()) {
+        stage.process(context);
+        return;
+    }
+    
+    auto* samples = block.getChannelPointer(0);
+    auto* dry = dryBuffer.getWritePointer(0);
+    const auto numSamples = (int) block.getNumSamples();
+    
+    std::copy(samples, samples + numSamples, dry);
+    stage.process(context);
+    
+    for (int i = 0; i < numSamples; ++i)
+        samples[i] = dry[i] + bypass.getGain(i) * (samples[i] - dry[i]);
+}
+
+template<typename ChainType>
+void EQEngine::updateBands(ChainType& left, ChainType& right, const ChainSettings &chainSettings)
+{
+    auto& leftBands = left.template get<ChainPositions::Bands>();
+    
+    //only the enabled bands are designed; the right chain shares the left one's coefficients
+    for (size_t band = 0; band < maxBands; ++band)
+        if (! chainSettings.bands[band].bypassed)
+            designBand(leftBands.getBand(band), chainSettings.bands[band], sampleRate);
+    
+    //unlinked, each chain only runs the bands on its own path
+    const auto linked = chainSettings.channelMode == ChannelMode::StereoLinked;
+    leftBands.setActiveBands(chainSettings.bands, 0, linked);
+    right.template get<ChainPositions::Bands>().setActiveBands(chainSettings.bands, 1, linked);
+}
+
+template<typename ChainType>
+void EQEngine::updateLowCutFilters(ChainType& left, ChainType& right, const ChainSettings &chainSettings)
+{
+    auto& leftLowCut = left.template get<ChainPositions::LowCut>();
+    const auto numSections = designCutFilter(leftLowCut, chainSettings.lowCutFreq, chainSettings.lowCutSlope,
+                                             chainSettings.lowCutShape, true, sampleRate);
+    
+    setActiveSections(leftLowCut, numSections);
+    setActiveSections(right.template get<ChainPositions::LowCut>(), numSections);
+}
+
+template<typename ChainType>
+void EQEngine::updateHighCutFilters(ChainType& left, ChainType& right, const ChainSettings &chainSettings)
+{
+    auto& leftHighCut = left.template get<ChainPositions::HighCut>();
+    const auto numSections = designCutFilter(leftHighCut, chainSettings.highCutFreq, chainSettings.highCutSlope,
+                                             chainSettings.highCutShape, false, sampleRate);
+    
+    setActiveSections(leftHighCut, numSections);
+    setActiveSections(right.template get<ChainPositions::HighCut>(), numSections);
+}
+
+template<typename ChainType>
+void EQEngine::updateFilters(ChainType& left, ChainType& right, const ChainSettings& chainSettings)
+{
+    updateLowCutFilters(left, right, chainSettings);
+    updateBands(left, right, chainSettings);
+    updateHighCutFilters(left, right, chainSettings);
+}
@@ -0,0 +1,305 @@
+/*
+  ==============================================================================
+
+    EQEngine.h
+    The IIR equaliser as a plain C++ object: prepare(), setSettings() and
+    process(), with no AudioProcessor, no parameters and no host behind it.
+
+    It owns the stereo chains of both topologies and everything that keeps
+    them click-free: settings picked up on a fixed grid and smoothed there,
+    slope, layout and topology changes crossfaded between two chain pairs,
+    stage bypass ramps, the dynamic bands and the Mid/Side and Left/Right
+    channel modes.
+    EQAudioProcessor wraps one and adds parameters, oversampling, linear
+    phase, the crossover and metering around it; anything else can link the
+    engine library and drive it straight from a ChainSettings.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "BandDynamics.h"
+#include "ChainDesign.h"
+
+#include <array>
+
+//Smoothed copies of the continuous parameters. Frequencies and Q glide
+//multiplicatively, so a sweep sounds even across the whole range.
+struct SmoothedBandSettings
+{
+    void reset(double sampleRate, double rampLengthSeconds)
+    {
+        freq.reset(sampleRate, rampLengthSeconds);
+        quality.reset(sampleRate, rampLengthSeconds);
+        gainDb.reset(sampleRate, rampLengthSeconds);
+    }
+    
+    void setCurrentAndTargetValues(const BandSettings& band)
+    {
+        freq.setCurrentAndTargetValue(band.freq);
+        quality.setCurrentAndTargetValue(band.quality);
+        gainDb.setCurrentAndTargetValue(band.gainDb);
+    }
+    
+    void setTargetValues(const BandSettings& band)
+    {
+        freq.setTargetValue(band.freq);
+        quality.setTargetValue(band.quality);
+        gainDb.setTargetValue(band.gainDb);
+    }
+    
+    bool isSmoothing() const { return freq.isSmoothing() || quality.isSmoothing() || gainDb.isSmoothing(); }
+    
+    void skip(int numSamples)
+    {
+        freq.skip(numSamples);
+        quality.skip(numSamples);
+        gainDb.skip(numSamples);
+    }
+    
+    void applyTo(BandSettings& band) const
+    {
+        band.freq = freq.getCurrentValue();
+        band.quality = quality.getCurrentValue();
+        band.gainDb = gainDb.getCurrentValue();
+    }
+    
+private:
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> freq, quality;
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> gainDb;
+};
+
+struct SmoothedChainSettings
+{
+    void reset(double sampleRate, double rampLengthSeconds)
+    {
+        for( auto* value : { &lowCutFreq, &highCutFreq } )
+            value->reset(sampleRate, rampLengthSeconds);
+        for( auto& band : bands )
+            band.reset(sampleRate, rampLengthSeconds);
+    }
+    
+    void setCurrentAndTargetValues(const ChainSettings& chainSettings)
+    {
+        lowCutFreq.setCurrentAndTargetValue(chainSettings.lowCutFreq);
+        highCutFreq.setCurrentAndTargetValue(chainSettings.highCutFreq);
+        for( size_t i = 0; i < maxBands; ++i )
+            bands[i].setCurrentAndTargetValues(chainSettings.bands[i]);
+    }
+    
+    void setTargetValues(const ChainSettings& chainSettings)
+    {
+        lowCutFreq.setTargetValue(chainSettings.lowCutFreq);
+        highCutFreq.setTargetValue(chainSettings.highCutFreq);
+        for( size_t i = 0; i < maxBands; ++i )
+            bands[i].setTargetValues(chainSettings.bands[i]);
+    }
+    
+    bool isSmoothing() const
+    {
+        if( lowCutFreq.isSmoothing() || highCutFreq.isSmoothing() )
+            return true;
+        
+        for( const auto& band : bands )
+            if( band.isSmoothing() )
+                return true;
+        
+        return false;
+    }
+    
+    void skip(int numSamples)
+    {
+        for( auto* value : { &lowCutFreq, &highCutFreq } )
+            value->skip(numSamples);
+        for( auto& band : bands )
+            band.skip(numSamples);
+    }
+    
+    //the given settings with their continuous values replaced by the current smoothed ones
+    ChainSettings applyTo(ChainSettings chainSettings) const
+    {
+        chainSettings.lowCutFreq = lowCutFreq.getCurrentValue();
+        chainSettings.highCutFreq = highCutFreq.getCurrentValue();
+        for( size_t i = 0; i < maxBands; ++i )
+            bands[i].applyTo(chainSettings.bands[i]);
+        return chainSettings;
+    }
+    
+private:
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> lowCutFreq, highCutFreq;
+    std::array<SmoothedBandSettings, maxBands> bands;
+};
+
+//==============================================================================
+//Click-free bypass of one stage of the chains: a bypassed stage is faded out and then
+//skipped entirely, a stage that is switched back on fades in from the dry signal.
+struct StageBypass
+{
+    void reset(bool bypassed, int rampLengthSamples)
+    {
+        rampLength = juce::jmax(1, rampLengthSamples);
+        enabled = ! bypassed;
+        gain = enabled ? 1.0f : 0.0f;
+        step = 0.0f;
+        remaining = 0;
+    }
+    
+    //returns true when a stage that had gone silent is switched back on
+    bool setBypassed(bool shouldBeBypassed)
+    {
+        if( enabled != shouldBeBypassed )
+            return false;
+        
+        const auto wasOff = isOff();
+        enabled = ! shouldBeBypassed;
+        
+        const auto target = enabled ? 1.0f : 0.0f;
+        remaining = juce::jmax(1, juce::roundToInt(std::abs(target - gain) * (float) rampLength));
+        step = (target - gain) / (float) remaining;
+        
+        return enabled && wasOff;
+    }
+    
+    bool isOff() const { return ! enabled && remaining == 0; }
+    bool isRamping() const { return remaining > 0; }
+    
+    //wet gain at sample i of the block about to be processed
+    float getGain(int i) const { return gain + step * (float) juce::jmin(i + 1, remaining); }
+    
+    void advance(int numSamples)
+    {
+        if( remaining == 0 )
+            return;
+        
+        const auto count = juce::jmin(numSamples, remaining);
+        remaining -= count;
+        gain = remaining == 0 ? (enabled ? 1.0f : 0.0f) : gain + step * (float) count;
+    }
+    
+private:
+    bool enabled = true;
+    float gain = 1.0f, step = 0.0f;
+    int rampLength = 1, remaining = 0;
+};
+
+//==============================================================================
+//One pass each way: mid = (l + r) / 2, side = (l - r) / 2, and back. The encoder reads
+//its input and writes its output separately, so a copy can be encoded on the way.
+void encodeMidSide(const juce::dsp::AudioBlock<float>& input, juce::dsp::AudioBlock<float>& output);
+void decodeMidSide(juce::dsp::AudioBlock<float>& block);
+
+//==============================================================================
+class EQEngine
+{
+public:
+    //settings are picked up, and coefficients designed, on this grid of absolute sample positions
+    static constexpr int smoothingSubBlockSize = 32;
+    static_assert(smoothingSubBlockSize == SvfHelpers::glideSamples, "the SVF sections glide across one grid cell");
+    
+    //Lets whoever drives the engine change its settings exactly on a grid point, e.g. to
+    //apply automation with sample accuracy. Called on the processing thread.
+    struct GridListener
+    {
+        virtual ~GridListener() = default;
+        
+        //the engine is about to read its settings for 'position', in samples since prepare()
+        virtual void gridPointReached(juce::int64 position) = 0;
+        
+        //where the listener's next change lands, or -1; until then the engine runs long segments
+        virtual juce::int64 getNextChangePosition() const { return -1; }
+    };
+    
+    //One or two channels; allocates, so not for the audio thread. The engine starts on
+    //the settings it was last given, with nothing gliding.
+    void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+    
+    //New settings, picked up on the next grid point; frequencies and gains glide there.
+    //Call it from the thread that calls process(), or between two process() calls.
+    void setSettings(const ChainSettings& newSettings) { targetSettings = newSettings; }
+    const ChainSettings& getSettings() const { return targetSettings; }
+    
+    //the next grid point jumps straight to the settings instead of gliding, from any thread
+    void snapToSettings() { snapSmoothing.set(true); }
+    
+    //clears every filter and snaps to the settings, for audio that does not follow on
+    void reset();
+    
+    //in place, up to the prepared block size and channel count
+    void process(float* const* channels, int numSamples);
+    
+    //The dynamic bands are keyed by the sidechain when it has channels, by the input otherwise.
+    //The sidechain may run at 1 / 2^sidechainOrder of the engine's rate, each sample held to fit.
+    void process(juce::dsp::AudioBlock<float>& block, const juce::AudioBuffer<float>& sidechain, int sidechainOrder = 0);
+    
+    //for time the engine does not process, so its grid stays on the same timeline
+    void advance(int numSamples) { samplePosition += numSamples; }
+    juce::int64 getPosition() const { return samplePosition; }
+    
+    double getSampleRate() const { return sampleRate; }
+    
+    void setGridListener(GridListener* newListener) { gridListener = newListener; }
+    
+private:
+    double sampleRate = 44100.0;
+    int numChannels = 2;
+    GridListener* gridListener = nullptr;
+    
+    //Two preallocated pairs per topology; the pair not in use is only there to crossfade
+    //slope, layout and topology changes. Each of the two slots runs one topology and one
+    //channel mode: the outgoing slot keeps its own while the new one fades in.
+    std::array<MonoChain, 2> leftChains, rightChains;
+    std::array<SvfMonoChain, 2> leftSvfChains, rightSvfChains;
+    int currentChains = 0;
+    std::array<FilterTopology, 2> chainTopologies {};
+    std::array<ChannelMode, 2> chainModes {};
+    
+    static constexpr double slopeTransitionSeconds = 0.02;
+    juce::AudioBuffer<float> transitionBuffer;
+    int transitionLength = 1, transitionSamplesRemaining = 0;
+    
+    static constexpr double bypassRampSeconds = 0.01;
+    std::array<StageBypass, 3> stageBypass;
+    juce::AudioBuffer<float> dryBuffer;
+    using StageFlags = std::array<bool, 3>;
+    
+    static constexpr double smoothingTimeSeconds = 0.05;
+    
+    ChainSettings targetSettings;
+    SmoothedChainSettings smoothedSettings;
+    juce::Atomic<bool> snapSmoothing = false;
+    ChainSettings designedSettings;
+    
+    juce::int64 samplePosition = 0;
+    
+    BandDynamics dynamics;
+    juce::AudioBuffer<float> detectorBuffer;
+    
+    void updateSettingsAt(juce::int64 position);
+    void updateDynamicBands(const ChainSettings& chainSettings);
+    void runDetectors(const juce::dsp::AudioBlock<float>& block, const juce::AudioBuffer<float>& sidechain, int sidechainOrder, int start, int numSamples);
+    
+    void processChains(juce::dsp::AudioBlock<float>& block);
+    //the left and right chains of one slot, in its topology, on one or two channels
+    void processSlot(int slot, juce::dsp::AudioBlock<float>& block);
+    template<typename ChainType>
+    void processPair(ChainType& left, ChainType& right, juce::dsp::AudioBlock<float>& block);
+    template<typename ChainArray>
+    void updateCurrentChains(ChainArray& left, ChainArray& right, const ChainSettings& chainSettings, const StageFlags& stagesToReset);
+    template<typename ChainType>
+    void processStages(ChainType& chain, juce::dsp::AudioBlock<float> block);
+    template<int Position, typename ChainType>
+    void processStage(ChainType& chain, juce::dsp::AudioBlock<float>& block);
+    
+    template<typename ChainType>
+    void updateBands(ChainType& left, ChainType& right, const ChainSettings& chainSettings);
+    template<typename ChainType>
+    void designDynamicBands(ChainType& chain, const BandArray& bands);
+    template<typename ChainType>
+    void updateLowCutFilters(ChainType& left, ChainType& right, const ChainSettings& chainSettings);
+    template<typename ChainType>
+    void updateHighCutFilters(ChainType& left, ChainType& right, const ChainSettings& chainSettings);
+    template<typename ChainType>
+    void updateFilters(ChainType& left, ChainType& right, const ChainSettings& chainSettings);
+};
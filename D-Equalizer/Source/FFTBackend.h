@@ -0,0 +1,301 @@
+/*
+  ==============================================================================
+
+    FFTBackend.h
+    Selectable forward FFT implementations for the analyzer.
+
+    - Juce : juce::dsp::FFT, which uses vDSP / IPP / FFTW when JUCE was built
+             with them and its generic radix fallback otherwise.
+    - Simd : the bundled header-only SimdRealFFT.
+    - FFTW : FFTW3 (single precision), only when the build defines DEQ_USE_FFTW.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "SharedCache.h"
+#include "SimdRealFFT.h"
+
+#if DEQ_USE_FFTW
+ #include <fftw3.h>
+#endif
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+enum class FFTBackendType
+{
+    Juce,
+    Simd,
+    FFTW
+};
+
+struct FFTBackend
+{
+    using Complex = std::complex<float>;
+
+    virtual ~FFTBackend() = default;
+
+    virtual FFTBackendType getType() const = 0;
+    virtual int getSize() const = 0;
+
+    /* complex forward transform of getSize() points, unscaled */
+    virtual void performComplexForward(const Complex* input, Complex* output) = 0;
+
+    /* real forward transform of getSize() samples into getSize() / 2 + 1 bins, unscaled */
+    virtual void performRealForward(const float* input, Complex* output) = 0;
+};
+
+//==============================================================================
+struct JuceFFTBackend : FFTBackend
+{
+    //the transform itself is const and shared by every backend of the same order
+    explicit JuceFFTBackend(int order)
+        : fft(SharedCache<int, juce::dsp::FFT>::getInstance().get(order, [order] { return std::make_shared<const juce::dsp::FFT>(order); })),
+          scratch((size_t) fft->getSize() * 2, 0.f) {}
+
+    FFTBackendType getType() const override { return FFTBackendType::Juce; }
+    int getSize() const override { return fft->getSize(); }
+
+    void performComplexForward(const Complex* input, Complex* output) override
+    {
+        fft->perform(input, output, false);
+    }
+
+    void performRealForward(const float* input, Complex* output) override
+    {
+        const auto size = fft->getSize();
+
+        std::copy(input, input + size, scratch.begin());
+        std::fill(scratch.begin() + size, scratch.end(), 0.f);
+
+        //leaves interleaved re/im pairs for bins 0 ... size / 2
+        fft->performRealOnlyForwardTransform(scratch.data(), true);
+
+        for( int k = 0; k <= size / 2; ++k )
+            output[k] = { scratch[2 * k], scratch[2 * k + 1] };
+    }
+
+private:
+    std::shared_ptr<const juce::dsp::FFT> fft;
+    std::vector<float> scratch;
+};
+
+struct SimdFFTBackend : FFTBackend
+{
+    explicit SimdFFTBackend(int order) : fft(order) {}
+
+    FFTBackendType getType() const override { return FFTBackendType::Simd; }
+    int getSize() const override { return fft.getSize(); }
+
+    void performComplexForward(const Complex* input, Complex* output) override { fft.performComplexForward(input, output); }
+    void performRealForward(const float* input, Complex* output) override { fft.performRealForward(input, output); }
+
+private:
+    SimdRealFFT fft;
+};
+
+#if DEQ_USE_FFTW
+struct FFTWBackend : FFTBackend
+{
+    explicit FFTWBackend(int order)
+        : size(1 << order),
+          plans(SharedCache<int, Plans>::getInstance().get(order, [order] { return std::make_shared<const Plans>(order); }))
+    {
+        complexIn = fftwf_alloc_complex((size_t) size);
+        complexOut = fftwf_alloc_complex((size_t) size);
+        realIn = fftwf_alloc_real((size_t) size);
+    }
+
+    ~FFTWBackend() override
+    {
+        fftwf_free(complexIn);
+        fftwf_free(complexOut);
+        fftwf_free(realIn);
+    }
+
+    FFTBackendType getType() const override { return FFTBackendType::FFTW; }
+    int getSize() const override { return size; }
+
+    void performComplexForward(const Complex* input, Complex* output) override
+    {
+        std::copy(input, input + size, reinterpret_cast<Complex*>(complexIn));
+        fftwf_execute_dft(plans->complexPlan, complexIn, complexOut);
+        std::copy_n(reinterpret_cast<const Complex*>(complexOut), size, output);
+    }
+
+    void performRealForward(const float* input, Complex* output) override
+    {
+        std::copy(input, input + size, realIn);
+        fftwf_execute_dft_r2c(plans->realPlan, realIn, complexOut);
+        std::copy_n(reinterpret_cast<const Complex*>(complexOut), size / 2 + 1, output);
+    }
+
+private:
+    static juce::CriticalSection& getPlannerLock()
+    {
+        static juce::CriticalSection lock;
+        return lock;
+    }
+
+    /*
+     Planning with FFTW_MEASURE takes a while, so each order is planned once and the plans
+     are shared. They run on each backend's own arrays through the new-array execute
+     functions, which are thread-safe; fftwf_alloc gives every array the alignment the
+     plans were made for.
+     */
+    struct Plans
+    {
+        explicit Plans(int order)
+        {
+            const int size = 1 << order;
+            auto* in = fftwf_alloc_complex((size_t) size);
+            auto* out = fftwf_alloc_complex((size_t) size);
+            auto* real = fftwf_alloc_real((size_t) size);
+
+            {
+                //the FFTW planner is not thread-safe
+                const juce::ScopedLock sl (getPlannerLock());
+                complexPlan = fftwf_plan_dft_1d(size, in, out, FFTW_FORWARD, FFTW_MEASURE);
+                realPlan = fftwf_plan_dft_r2c_1d(size, real, out, FFTW_MEASURE);
+            }
+
+            fftwf_free(in);
+            fftwf_free(out);
+            fftwf_free(real);
+        }
+
+        ~Plans()
+        {
+            const juce::ScopedLock sl (getPlannerLock());
+            fftwf_destroy_plan(complexPlan);
+            fftwf_destroy_plan(realPlan);
+        }
+
+        fftwf_plan complexPlan = nullptr, realPlan = nullptr;
+
+        JUCE_DECLARE_NON_COPYABLE(Plans)
+    };
+
+    const int size;
+    const std::shared_ptr<const Plans> plans;
+    fftwf_complex* complexIn = nullptr;
+    fftwf_complex* complexOut = nullptr;
+    float* realIn = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE(FFTWBackend)
+};
+#endif
+
+//==============================================================================
+inline bool isFFTBackendAvailable(FFTBackendType type)
+{
+   #if DEQ_USE_FFTW
+    juce::ignoreUnused(type);
+    return true;
+   #else
+    return type != FFTBackendType::FFTW;
+   #endif
+}
+
+/*
+ JUCE already forwards to vDSP on macOS and to IPP / FFTW when it was built with them.
+ Everywhere else its fallback is the slowest option, so prefer FFTW, then the bundled FFT.
+ */
+inline FFTBackendType getDefaultFFTBackendType()
+{
+   #if JUCE_MAC || JUCE_IOS || JUCE_IPP_AVAILABLE || JUCE_DSP_USE_INTEL_MKL || JUCE_DSP_USE_STATIC_FFTW || JUCE_DSP_USE_SHARED_FFTW
+    return FFTBackendType::Juce;
+   #elif DEQ_USE_FFTW
+    return FFTBackendType::FFTW;
+   #else
+    return FFTBackendType::Simd;
+   #endif
+}
+
+inline std::unique_ptr<FFTBackend> createFFTBackend(FFTBackendType type, int order)
+{
+    switch (type)
+    {
+        case FFTBackendType::FFTW:
+           #if DEQ_USE_FFTW
+            return std::make_unique<FFTWBackend>(order);
+           #else
+            jassertfalse; //not compiled in, fall back to the bundled FFT
+            return std::make_unique<SimdFFTBackend>(order);
+           #endif
+        case FFTBackendType::Simd:
+            return std::make_unique<SimdFFTBackend>(order);
+        case FFTBackendType::Juce:
+            break;
+    }
+
+    return std::make_unique<JuceFFTBackend>(order);
+}
+
+inline const char* getFFTBackendName(FFTBackendType type)
+{
+    switch (type)
+    {
+        case FFTBackendType::Juce: return "juce";
+        case FFTBackendType::Simd: return "simd";
+        case FFTBackendType::FFTW: return "fftw";
+    }
+
+    return "";
+}
+
+//==============================================================================
+struct FFTBenchmarkResult
+{
+    FFTBackendType type;
+    int order;
+    double nanosecondsPerComplexTransform, nanosecondsPerRealTransform;
+};
+
+/* times every available backend at the given order, for choosing the default on a new machine */
+inline std::vector<FFTBenchmarkResult> benchmarkFFTBackends(int order, int numIterations)
+{
+    std::vector<FFTBenchmarkResult> results;
+
+    const int size = 1 << order;
+    juce::Random random (0x0de9);
+
+    std::vector<FFTBackend::Complex> complexInput ((size_t) size), complexOutput ((size_t) size);
+    std::vector<float> realInput ((size_t) size);
+
+    for( int i = 0; i < size; ++i )
+    {
+        complexInput[i] = { random.nextFloat() - 0.5f, random.nextFloat() - 0.5f };
+        realInput[i] = random.nextFloat() - 0.5f;
+    }
+
+    for( auto type : { FFTBackendType::Juce, FFTBackendType::Simd, FFTBackendType::FFTW } )
+    {
+        if( ! isFFTBackendAvailable(type) )
+            continue;
+
+        auto backend = createFFTBackend(type, order);
+
+        auto time = [&](auto&& transform)
+        {
+            transform(); //warm up caches and lazily initialised tables
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            for( int i = 0; i < numIterations; ++i )
+                transform();
+            const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+            return elapsed * 1.0e9 / numIterations;
+        };
+
+        results.push_back({ type, order,
+                            time([&] { backend->performComplexForward(complexInput.data(), complexOutput.data()); }),
+                            time([&] { backend->performRealForward(realInput.data(), complexOutput.data()); }) });
+    }
+
+    return results;
+}
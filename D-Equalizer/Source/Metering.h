@@ -0,0 +1,325 @@
+/*
+  ==============================================================================
+
+    Metering.h
+    Peak, RMS, true-peak and loudness (ITU-R BS.1770 momentary / short-term)
+    meters computed on the audio thread and published through atomics.
+
+    Everything is allocated in prepare(). process() never allocates and does
+    nothing while all meters are switched off.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <atomic>
+
+enum MeterTap
+{
+    Input,
+    Output,
+    NumMeterTaps
+};
+
+struct MeterOptions
+{
+    bool levels {false}, truePeak {false}, loudness {false};
+
+    bool anyEnabled() const { return levels || truePeak || loudness; }
+};
+
+//all values in dB (LUFS for the loudness values), -100 when silent or switched off
+struct MeterReadings
+{
+    float peakDb {-100.f}, rmsDb {-100.f}, truePeakDb {-100.f};
+    float momentaryLufs {-100.f}, shortTermLufs {-100.f};
+};
+
+namespace MeterHelpers
+{
+    constexpr float silenceDb = -100.0f;
+
+    inline float toDb(float gain)
+    {
+        return juce::Decibels::gainToDecibels(gain, silenceDb);
+    }
+
+    inline float loudnessFromMeanSquare(double meanSquare)
+    {
+        return meanSquare > 0.0 ? juce::jmax(silenceDb, (float) (-0.691 + 10.0 * std::log10(meanSquare))) : silenceDb;
+    }
+
+    inline float getPeak(const float* samples, int numSamples)
+    {
+        const auto range = juce::FloatVectorOperations::findMinAndMax(samples, numSamples);
+        return juce::jmax(std::abs(range.getStart()), std::abs(range.getEnd()));
+    }
+
+    inline double getSumOfSquares(const float* samples, int numSamples)
+    {
+        float sum = 0.f;
+        int i = 0;
+
+       #if JUCE_USE_SIMD
+        using Vec = juce::dsp::SIMDRegister<float>;
+        constexpr int vecSize = (int) Vec::SIMDNumElements;
+
+        //scalar head up to the first aligned sample, then whole registers
+        auto* aligned = Vec::getNextSIMDAlignedPtr(const_cast<float*>(samples));
+        const int head = juce::jmin(numSamples, (int) (aligned - samples));
+
+        for( ; i < head; ++i )
+            sum += samples[i] * samples[i];
+
+        auto acc = Vec::expand(0.f);
+        for( ; i + vecSize <= numSamples; i += vecSize )
+        {
+            const auto v = Vec::fromRawArray(samples + i);
+            acc += v * v;
+        }
+        sum += acc.sum();
+       #endif
+
+        for( ; i < numSamples; ++i )
+            sum += samples[i] * samples[i];
+
+        return (double) sum;
+    }
+
+    //ITU-R BS.1770 K-weighting, designed for any sample rate
+    inline juce::dsp::IIR::Coefficients<float>::Ptr makeKWeightingShelf(double sampleRate)
+    {
+        const double f0 = 1681.974450955533, gainDb = 3.999843853973347, q = 0.7071752369554196;
+        const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gainDb / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+
+        return new juce::dsp::IIR::Coefficients<float>((float) (vh + vb * k / q + k * k),
+                                                       (float) (2.0 * (k * k - vh)),
+                                                       (float) (vh - vb * k / q + k * k),
+                                                       (float) (1.0 + k / q + k * k),
+                                                       (float) (2.0 * (k * k - 1.0)),
+                                                       (float) (1.0 - k / q + k * k));
+    }
+
+    inline juce::dsp::IIR::Coefficients<float>::Ptr makeKWeightingHighPass(double sampleRate)
+    {
+        const double f0 = 38.13547087602444, q = 0.5003270373238773;
+        const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+
+        return new juce::dsp::IIR::Coefficients<float>(1.f, -2.f, 1.f,
+                                                       (float) (1.0 + k / q + k * k),
+                                                       (float) (2.0 * (k * k - 1.0)),
+                                                       (float) (1.0 - k / q + k * k));
+    }
+}
+
+struct LevelMeter
+{
+    void prepare(double sampleRate, int maximumBlockSize, int channels)
+    {
+        numChannels = juce::jmax(1, channels);
+        maxBlockSize = juce::jmax(1, maximumBlockSize);
+
+        //ballistics: peaks fall by 20 dB/s, RMS is a 300 ms exponential average
+        peakFallPerSample = (float) std::pow(10.0, -20.0 / 20.0 / sampleRate);
+        rmsCoefficient = (float) std::exp(-1.0 / (0.3 * sampleRate));
+
+        //true peak: 4x polyphase IIR oversampling
+        oversampling = std::make_unique<juce::dsp::Oversampling<float>>((size_t) numChannels, 2,
+                                                                        juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR,
+                                                                        false);
+        oversampling->initProcessing((size_t) maxBlockSize);
+
+        //loudness: K-weighting with the EQ's IIR filters, measured in 100 ms steps
+        kWeightedBuffer.setSize(numChannels, maxBlockSize);
+
+        auto shelf = MeterHelpers::makeKWeightingShelf(sampleRate);
+        auto highPass = MeterHelpers::makeKWeightingHighPass(sampleRate);
+
+        juce::dsp::ProcessSpec spec;
+        spec.sampleRate = sampleRate;
+        spec.maximumBlockSize = (juce::uint32) maxBlockSize;
+        spec.numChannels = 1;
+
+        kWeighting.resize((size_t) numChannels);
+        for( auto& chain : kWeighting )
+        {
+            chain.get<0>().coefficients = shelf;
+            chain.get<1>().coefficients = highPass;
+            chain.prepare(spec);
+        }
+
+        samplesPerLoudnessStep = juce::jmax(1, juce::roundToInt(sampleRate / 10.0));
+
+        reset();
+    }
+
+    void reset()
+    {
+        peak = truePeak = 0.f;
+        meanSquare = 0.f;
+
+        if( oversampling != nullptr )
+            oversampling->reset();
+
+        for( auto& chain : kWeighting )
+            chain.reset();
+
+        loudnessSteps.fill(0.0);
+        loudnessStepIndex = 0;
+        stepSum = 0.0;
+        stepSamples = 0;
+
+        for( auto* value : { &peakDb, &rmsDb, &truePeakDb, &momentaryLufs, &shortTermLufs } )
+            value->store(MeterHelpers::silenceDb);
+    }
+
+    //audio thread
+    void process(const juce::AudioBuffer<float>& buffer, const MeterOptions& options)
+    {
+        if( ! options.anyEnabled() )
+            return;
+
+        const int channels = juce::jmin(numChannels, buffer.getNumChannels());
+
+        for( int start = 0; start < buffer.getNumSamples(); start += maxBlockSize )
+        {
+            const int numSamples = juce::jmin(maxBlockSize, buffer.getNumSamples() - start);
+
+            if( options.levels )
+                processLevels(buffer, channels, start, numSamples);
+
+            if( options.truePeak )
+                processTruePeak(buffer, channels, start, numSamples);
+
+            if( options.loudness )
+                processLoudness(buffer, channels, start, numSamples);
+        }
+
+        if( options.levels )
+        {
+            peakDb.store(MeterHelpers::toDb(peak));
+            rmsDb.store(MeterHelpers::toDb(std::sqrt(meanSquare)));
+        }
+
+        if( options.truePeak )
+            truePeakDb.store(MeterHelpers::toDb(truePeak));
+    }
+
+    //any thread
+    MeterReadings getReadings() const
+    {
+        MeterReadings readings;
+        readings.peakDb = peakDb.load();
+        readings.rmsDb = rmsDb.load();
+        readings.truePeakDb = truePeakDb.load();
+        readings.momentaryLufs = momentaryLufs.load();
+        readings.shortTermLufs = shortTermLufs.load();
+        return readings;
+    }
+
+private:
+    void processLevels(const juce::AudioBuffer<float>& buffer, int channels, int start, int numSamples)
+    {
+        float blockPeak = 0.f;
+        double blockSquares = 0.0;
+
+        for( int ch = 0; ch < channels; ++ch )
+        {
+            const auto* samples = buffer.getReadPointer(ch, start);
+            blockPeak = juce::jmax(blockPeak, MeterHelpers::getPeak(samples, numSamples));
+            blockSquares = juce::jmax(blockSquares, MeterHelpers::getSumOfSquares(samples, numSamples));
+        }
+
+        peak = juce::jmax(blockPeak, peak * std::pow(peakFallPerSample, (float) numSamples));
+
+        const auto decay = std::pow(rmsCoefficient, (float) numSamples);
+        meanSquare = decay * meanSquare + (1.f - decay) * (float) (blockSquares / numSamples);
+    }
+
+    void processTruePeak(const juce::AudioBuffer<float>& buffer, int channels, int start, int numSamples)
+    {
+        juce::dsp::AudioBlock<const float> block (buffer.getArrayOfReadPointers(), (size_t) channels,
+                                                  (size_t) start, (size_t) numSamples);
+        auto oversampled = oversampling->processSamplesUp(block);
+
+        float blockPeak = 0.f;
+        for( size_t ch = 0; ch < (size_t) channels; ++ch )
+            blockPeak = juce::jmax(blockPeak, MeterHelpers::getPeak(oversampled.getChannelPointer(ch),
+                                                                    (int) oversampled.getNumSamples()));
+
+        truePeak = juce::jmax(blockPeak, truePeak * std::pow(peakFallPerSample, (float) numSamples));
+    }
+
+    void processLoudness(const juce::AudioBuffer<float>& buffer, int channels, int start, int numSamples)
+    {
+        for( int ch = 0; ch < channels; ++ch )
+        {
+            kWeightedBuffer.copyFrom(ch, 0, buffer, ch, start, numSamples);
+
+            auto block = juce::dsp::AudioBlock<float>(kWeightedBuffer).getSingleChannelBlock((size_t) ch)
+                                                                       .getSubBlock(0, (size_t) numSamples);
+            kWeighting[(size_t) ch].process(juce::dsp::ProcessContextReplacing<float>(block));
+        }
+
+        //accumulate the channel sum in 100 ms steps
+        int done = 0;
+        while( done < numSamples )
+        {
+            const int count = juce::jmin(numSamples - done, samplesPerLoudnessStep - stepSamples);
+
+            for( int ch = 0; ch < channels; ++ch )
+                stepSum += MeterHelpers::getSumOfSquares(kWeightedBuffer.getReadPointer(ch, done), count);
+
+            stepSamples += count;
+            done += count;
+
+            if( stepSamples == samplesPerLoudnessStep )
+                finishLoudnessStep();
+        }
+    }
+
+    void finishLoudnessStep()
+    {
+        loudnessSteps[(size_t) loudnessStepIndex] = stepSum / samplesPerLoudnessStep;
+        loudnessStepIndex = (loudnessStepIndex + 1) % (int) loudnessSteps.size();
+        stepSum = 0.0;
+        stepSamples = 0;
+
+        //momentary: the last 4 steps (400 ms), short-term: the last 30 steps (3 s)
+        auto average = [this](int numSteps)
+        {
+            double sum = 0.0;
+            for( int i = 1; i <= numSteps; ++i )
+                sum += loudnessSteps[(size_t) ((loudnessStepIndex - i + (int) loudnessSteps.size()) % (int) loudnessSteps.size())];
+            return sum / numSteps;
+        };
+
+        momentaryLufs.store(MeterHelpers::loudnessFromMeanSquare(average(4)));
+        shortTermLufs.store(MeterHelpers::loudnessFromMeanSquare(average(30)));
+    }
+
+    using KWeighting = juce::dsp::ProcessorChain<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Filter<float>>;
+
+    int numChannels = 2, maxBlockSize = 512;
+
+    float peakFallPerSample = 1.f, rmsCoefficient = 0.f;
+    float peak = 0.f, truePeak = 0.f, meanSquare = 0.f;
+
+    std::unique_ptr<juce::dsp::Oversampling<float>> oversampling;
+
+    juce::AudioBuffer<float> kWeightedBuffer;
+    std::vector<KWeighting> kWeighting;
+    int samplesPerLoudnessStep = 4800, stepSamples = 0;
+    double stepSum = 0.0;
+    std::array<double, 30> loudnessSteps {};
+    int loudnessStepIndex = 0;
+
+    std::atomic<float> peakDb {MeterHelpers::silenceDb}, rmsDb {MeterHelpers::silenceDb}, truePeakDb {MeterHelpers::silenceDb};
+    std::atomic<float> momentaryLufs {MeterHelpers::silenceDb}, shortTermLufs {MeterHelpers::silenceDb};
+};
@@ -0,0 +1,606 @@
+/*
+  ==============================================================================
+
+    OfflineRender.cpp
+
+  ==============================================================================
+*/
+
+#include "OfflineRender.h"
+
+#include <algorithm>
+#include <functional>
+
+//==============================================================================
+void ChannelGroupProcessor::prepare(const RenderOptions& options, double sampleRate, int newNumChannels)
+{
+    numChannels = juce::jlimit(1, 2, newNumChannels);
+
+    //the same half-bands as the plugin, so a render matches what it plays
+    oversampler.reset();
+    if (options.oversamplingOrder > 0) {
+        oversampler = std::make_unique<juce::dsp::Oversampling<float>>((size_t) numChannels, (size_t) options.oversamplingOrder,
+                                                                      juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR,
+                                                                      true);
+        oversampler->initProcessing((size_t) options.blockSize);
+    }
+
+    const auto factor = 1 << juce::jmax(0, options.oversamplingOrder);
+    engine.setSettings(options.settings);
+    engine.prepare(sampleRate * factor, options.blockSize * factor, numChannels);
+}
+
+void ChannelGroupProcessor::process(float* const* channels, int numSamples)
+{
+    juce::dsp::AudioBlock<float> block (channels, (size_t) numChannels, (size_t) numSamples);
+
+    if (oversampler == nullptr) {
+        engine.process(block, noSidechain);
+        return;
+    }
+
+    auto oversampledBlock = oversampler->processSamplesUp(block);
+    engine.process(oversampledBlock, noSidechain);
+    oversampler->processSamplesDown(block);
+}
+
+int ChannelGroupProcessor::getLatency() const
+{
+    return oversampler != nullptr ? juce::roundToInt(oversampler->getLatencyInSamples()) : 0;
+}
+
+//==============================================================================
+std::unique_ptr<juce::AudioFormatWriter> createRenderWriter(juce::AudioFormatManager& formats,
+                                                            const juce::File& output,
+                                                            const juce::AudioFormatReader& source,
+                                                            int bitsPerSample,
+                                                            juce::String& error)
+{
+    auto* format = formats.findFormatForFileExtension(output.getFileExtension());
+
+    if (format == nullptr) {
+        error = "no writer for " + output.getFileExtension() + " files";
+        return {};
+    }
+
+    //the source's depth where the format has it, 24 bits otherwise
+    if (bitsPerSample == 0)
+        bitsPerSample = format->getPossibleBitDepths().contains((int) source.bitsPerSample) ? (int) source.bitsPerSample : 24;
+
+    if (! format->getPossibleBitDepths().contains(bitsPerSample)) {
+        error = format->getFormatName() + " cannot be written at " + juce::String(bitsPerSample) + " bits";
+        return {};
+    }
+
+    output.deleteFile();
+    auto stream = std::make_unique<juce::FileOutputStream>(output);
+
+    if (! stream->openedOk()) {
+        error = "cannot write " + output.getFullPathName();
+        return {};
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor(stream.get(),
+                                                                             source.sampleRate,
+                                                                             source.numChannels,
+                                                                             bitsPerSample,
+                                                                             {},
+                                                                             0));
+
+    //on success the writer owns the stream; on failure the empty file it made goes again
+    if (writer == nullptr) {
+        error = format->getFormatName() + " cannot hold " + juce::String((int) source.numChannels) + " channels at this rate and depth";
+        stream.reset();
+        output.deleteFile();
+    } else {
+        stream.release();
+    }
+
+    return writer;
+}
+
+//==============================================================================
+int getChannelGroupSize(const ChainSettings& settings)
+{
+    if (settings.channelMode != ChannelMode::StereoLinked)
+        return 2;
+
+    for (const auto& band : settings.bands)
+        if (BandDynamics::isDynamic(band))
+            return 2;
+
+    return 1;
+}
+
+juce::int64 getNumRenderBlocks(juce::int64 length, int latency, int blockSize)
+{
+    return length > 0 ? (length + latency + blockSize - 1) / blockSize : 0;
+}
+
+RenderBlock getRenderBlock(juce::int64 index, juce::int64 length, int latency, int blockSize)
+{
+    RenderBlock block;
+    block.start = index * blockSize;
+    block.numSamples = (int) juce::jmin((juce::int64) blockSize, length + latency - block.start);
+    block.numToRead = (int) juce::jlimit((juce::int64) 0, (juce::int64) block.numSamples, length - block.start);
+    block.numToSkip = (int) juce::jlimit((juce::int64) 0, (juce::int64) block.numSamples, latency - block.start);
+    block.numToWrite = block.numSamples - block.numToSkip;
+    return block;
+}
+
+//==============================================================================
+//One file's reader, writer and channel groups, and a ring of queueDepth blocks between
+//them; block i lives in slot i % queueDepth. Each step works on one block. Steps on
+//different blocks, or different groups of one block, may run on different threads;
+//keeping the order within each kind of step is up to the caller.
+class FileRender
+{
+public:
+    FileRender(const RenderOptions& renderOptions, int queueDepth)
+        : options(renderOptions), slots((size_t) juce::jmax(1, queueDepth)), slotChannels(slots.size())
+    {
+    }
+
+    juce::Result open(const juce::File& input, const juce::File& output);
+
+    juce::int64 getNumBlocks() const { return numBlocks; }
+    size_t getNumGroups() const { return groups.size(); }
+
+    //false if the reader could not deliver the block
+    bool read(juce::int64 index);
+    //the samples it filtered, every channel counted
+    juce::int64 process(juce::int64 index, size_t group);
+    bool write(juce::int64 index);
+
+    //flushes the output, or deletes it when a step failed and it is incomplete
+    void close(bool keepOutput = true);
+
+    RenderStats getStats() const { return stats; }
+
+private:
+    RenderOptions options;
+
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    juce::File outputFile;
+    std::vector<ChannelGroupProcessor> groups;
+    int groupSize = 2;
+
+    //the groups filter through raw channel pointers, looked up once, so that nothing
+    //touches an AudioBuffer from two threads
+    std::vector<juce::AudioBuffer<float>> slots;
+    std::vector<std::vector<float*>> slotChannels;
+    std::vector<const float*> writePointers;
+
+    juce::int64 length = 0, numBlocks = 0;
+    int latency = 0;
+
+    double startTime = 0.0;
+    RenderStats stats;
+
+    size_t getSlot(juce::int64 index) const { return (size_t) (index % (juce::int64) slots.size()); }
+};
+
+juce::Result FileRender::open(const juce::File& input, const juce::File& output)
+{
+    startTime = juce::Time::getMillisecondCounterHiRes();
+
+    if (input == output)
+        return juce::Result::fail("refusing to render " + input.getFullPathName() + " onto itself");
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    reader.reset(formats.createReaderFor(input));
+    if (reader == nullptr)
+        return juce::Result::fail("cannot read " + input.getFullPathName());
+
+    juce::String error;
+    writer = createRenderWriter(formats, output, *reader, options.bitsPerSample, error);
+    if (writer == nullptr)
+        return juce::Result::fail(error);
+
+    outputFile = output;
+    const auto numChannels = (int) reader->numChannels;
+    groupSize = getChannelGroupSize(options.settings);
+    groups = std::vector<ChannelGroupProcessor>((size_t) ((numChannels + groupSize - 1) / groupSize));
+
+    for (size_t g = 0; g < groups.size(); ++g)
+        groups[g].prepare(options, reader->sampleRate, juce::jmin(groupSize, numChannels - groupSize * (int) g));
+
+    latency = groups.empty() ? 0 : groups.front().getLatency();
+    length = reader->lengthInSamples;
+    numBlocks = getNumRenderBlocks(length, latency, options.blockSize);
+
+    for (size_t s = 0; s < slots.size(); ++s) {
+        slots[s].setSize(numChannels, options.blockSize);
+        slotChannels[s].assign(slots[s].getArrayOfWritePointers(), slots[s].getArrayOfWritePointers() + numChannels);
+    }
+    writePointers.resize((size_t) numChannels);
+
+    stats.numChannels = numChannels;
+    stats.sampleRate = reader->sampleRate;
+    stats.numSamples = length;
+
+    return juce::Result::ok();
+}
+
+bool FileRender::read(juce::int64 index)
+{
+    const auto block = getRenderBlock(index, length, latency, options.blockSize);
+    auto& slot = slots[getSlot(index)];
+
+    if (block.numToRead > 0 && ! reader->read(&slot, 0, block.numToRead, block.start, true, true))
+        return false;
+    if (block.numToRead < block.numSamples)
+        slot.clear(block.numToRead, block.numSamples - block.numToRead);
+
+    return true;
+}
+
+juce::int64 FileRender::process(juce::int64 index, size_t group)
+{
+    const auto block = getRenderBlock(index, length, latency, options.blockSize);
+    auto& channels = slotChannels[getSlot(index)];
+    const auto first = groupSize * (int) group;
+
+    groups[group].process(channels.data() + first, block.numSamples);
+
+    return (juce::int64) block.numSamples * juce::jmin(groupSize, (int) channels.size() - first);
+}
+
+bool FileRender::write(juce::int64 index)
+{
+    const auto block = getRenderBlock(index, length, latency, options.blockSize);
+    const auto& channels = slotChannels[getSlot(index)];
+
+    if (block.numToWrite == 0)
+        return true;
+
+    for (size_t ch = 0; ch < channels.size(); ++ch)
+        writePointers[ch] = channels[ch] + block.numToSkip;
+
+    return writer->writeFromFloatArrays(writePointers.data(), (int) writePointers.size(), block.numToWrite);
+}
+
+void FileRender::close(bool keepOutput)
+{
+    writer.reset();
+    reader.reset();
+
+    if (! keepOutput)
+        outputFile.deleteFile();
+
+    //a batch keeps every file's FileRender to the end, but not its buffers
+    groups.clear();
+    slotChannels.clear();
+    slots.clear();
+
+    stats.seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+}
+
+//==============================================================================
+juce::Result renderFile(const juce::File& input, const juce::File& output, const RenderOptions& options, RenderStats* stats)
+{
+    FileRender render (options, 1);
+
+    const auto result = render.open(input, output);
+    if (result.failed())
+        return result;
+
+    for (juce::int64 i = 0; i < render.getNumBlocks(); ++i) {
+        if (! render.read(i)) {
+            render.close(false);
+            return juce::Result::fail("read failed: " + input.getFullPathName());
+        }
+
+        for (size_t g = 0; g < render.getNumGroups(); ++g)
+            render.process(i, g);
+
+        if (! render.write(i)) {
+            render.close(false);
+            return juce::Result::fail("write failed: " + output.getFullPathName());
+        }
+    }
+
+    render.close();
+
+    if (stats != nullptr)
+        *stats = render.getStats();
+
+    return juce::Result::ok();
+}
+
+//==============================================================================
+/*
+ A FileRender as tasks on the pool. Reads and writes go in block order, one at a time,
+ and each channel group filters its blocks in order; everything else overlaps. A block
+ is read once its slot has been written out, so at most queueDepth blocks are between
+ the reader and the writer. Every step that finishes schedules whatever it unblocked.
+ */
+class FilePipeline
+{
+public:
+    FilePipeline(WorkStealingPool& workers, const RenderOptions& options, int depth, std::function<void()> onFinished)
+        : pool(workers), render(options, depth), queueDepth(depth), finished(std::move(onFinished))
+    {
+    }
+
+    juce::Result open(const BatchJob& job)
+    {
+        input = job.input;
+        output = job.output;
+
+        const auto result = render.open(job.input, job.output);
+        groupNext.assign(render.getNumGroups(), 0);
+        groupBusy.assign(render.getNumGroups(), false);
+        return result;
+    }
+
+    void start()
+    {
+        bool fileDone;
+        {
+            const juce::ScopedLock sl (lock);
+            schedule();
+            fileDone = takeFinished();
+        }
+
+        if (fileDone)
+            finish();
+    }
+
+    juce::Result getResult() const { return result; }
+    RenderStats getStats() const { return render.getStats(); }
+
+private:
+    WorkStealingPool& pool;
+    FileRender render;
+    const int queueDepth;
+    std::function<void()> finished;
+    juce::File input, output;
+
+    juce::CriticalSection lock;
+    juce::int64 nextRead = 0, nextWrite = 0;
+    bool reading = false, writing = false;
+    std::vector<juce::int64> groupNext;
+    std::vector<bool> groupBusy;
+    int tasksInFlight = 0;
+    bool failed = false, done = false;
+    juce::String failure;       //what the first failed step reports
+    juce::Result result = juce::Result::ok();
+
+    //under the lock
+    void schedule()
+    {
+        if (failed)
+            return;
+
+        if (! reading && nextRead < render.getNumBlocks() && nextRead < nextWrite + queueDepth) {
+            reading = true;
+            submit([this, block = nextRead] { return render.read(block) ? (juce::int64) 0 : (juce::int64) -1; },
+                   [this] { reading = false; ++nextRead; },
+                   "read failed: " + input.getFullPathName());
+        }
+
+        for (size_t g = 0; g < groupNext.size(); ++g) {
+            if (groupBusy[g] || groupNext[g] >= nextRead)
+                continue;
+
+            groupBusy[g] = true;
+            submit([this, g, block = groupNext[g]] { return render.process(block, g); },
+                   [this, g] { groupBusy[g] = false; ++groupNext[g]; },
+                   {});
+        }
+
+        const auto filtered = std::all_of(groupNext.begin(), groupNext.end(), [this](juce::int64 next) { return next > nextWrite; });
+
+        if (! writing && nextWrite < nextRead && filtered) {
+            writing = true;
+            submit([this, block = nextWrite] { return render.write(block) ? (juce::int64) 0 : (juce::int64) -1; },
+                   [this] { writing = false; ++nextWrite; },
+                   "write failed: " + output.getFullPathName());
+        }
+    }
+
+    //'step' returns its work, or -1 if it failed with 'failureMessage'; 'advance' records
+    //it, under the lock
+    template<typename Step, typename Advance>
+    void submit(Step step, Advance advance, const juce::String& failureMessage)
+    {
+        ++tasksInFlight;
+
+        pool.submit([this, step, advance, failureMessage]
+        {
+            const auto work = step();
+            bool fileDone;
+            {
+                const juce::ScopedLock sl (lock);
+                --tasksInFlight;
+
+                if (work >= 0)
+                    advance();
+                else if (! failed) {
+                    failed = true;
+                    failure = failureMessage;
+                }
+
+                schedule();
+                fileDone = takeFinished();
+            }
+
+            if (fileDone)
+                finish();
+
+            return juce::jmax((juce::int64) 0, work);
+        });
+    }
+
+    //true once, when the last step is done or nothing more will run after a failure; under the lock
+    bool takeFinished()
+    {
+        if (done || tasksInFlight > 0 || ! (failed || nextWrite == render.getNumBlocks()))
+            return false;
+
+        done = true;
+        return true;
+    }
+
+    void finish()
+    {
+        render.close(! failed);
+
+        if (failed)
+            result = juce::Result::fail(failure);
+
+        finished();
+    }
+};
+
+//==============================================================================
+//opens files while fewer than maxOpenFiles are running, and one more each time one closes
+class BatchRender
+{
+public:
+    BatchRender(const std::vector<BatchJob>& batchJobs, const RenderOptions& renderOptions, const BatchOptions& batchOptions)
+        : jobs(batchJobs),
+          options(renderOptions),
+          queueDepth(juce::jmax(1, batchOptions.queueDepth)),
+          pool(batchOptions.numWorkers > 0 ? batchOptions.numWorkers : juce::SystemStats::getNumCpus())
+    {
+        maxOpenFiles = batchOptions.maxOpenFiles > 0 ? batchOptions.maxOpenFiles : 2 * pool.getNumWorkers();
+    }
+
+    BatchReport run()
+    {
+        const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+        checks = checkBatchJobs(jobs);
+        report.results.assign(jobs.size(), juce::Result::ok());
+        report.files.assign(jobs.size(), {});
+        pipelines.resize(jobs.size());
+
+        if (jobs.empty())
+            allDone.signal();
+
+        startFiles();
+        allDone.wait();
+
+        //the last task's counts land after its file is reported done
+        pool.stop();
+        report.workers = pool.getStats();
+        report.seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+        return report;
+    }
+
+private:
+    const std::vector<BatchJob>& jobs;
+    const RenderOptions options;
+    const int queueDepth;
+    int maxOpenFiles = 1;
+
+    std::vector<juce::Result> checks;
+
+    juce::CriticalSection lock;
+    size_t nextJob = 0, numDone = 0;
+    int numOpen = 0;
+    std::vector<std::unique_ptr<FilePipeline>> pipelines;
+    BatchReport report;
+    juce::WaitableEvent allDone;
+
+    //last, so it stops before the pipelines its tasks point to go away
+    WorkStealingPool pool;
+
+    void startFiles()
+    {
+        for (;;) {
+            size_t job;
+            {
+                const juce::ScopedLock sl (lock);
+                if (numOpen >= maxOpenFiles || nextJob >= jobs.size())
+                    return;
+
+                job = nextJob++;
+
+                //a clash with another job's file fails here, before anything is opened
+                if (checks[job].failed()) {
+                    report.results[job] = checks[job];
+                    if (++numDone == jobs.size())
+                        allDone.signal();
+                    continue;
+                }
+
+                ++numOpen;
+            }
+
+            auto pipeline = std::make_unique<FilePipeline>(pool, options, queueDepth, [this, job] { fileFinished(job); });
+            const auto result = pipeline->open(jobs[job]);
+            auto& started = *pipeline;
+            {
+                const juce::ScopedLock sl (lock);
+                pipelines[job] = std::move(pipeline);
+            }
+
+            if (result.wasOk()) {
+                started.start();
+                continue;
+            }
+
+            //a file that does not open never reaches the pool
+            const juce::ScopedLock sl (lock);
+            report.results[job] = result;
+            --numOpen;
+            if (++numDone == jobs.size())
+                allDone.signal();
+        }
+    }
+
+    void fileFinished(size_t job)
+    {
+        {
+            const juce::ScopedLock sl (lock);
+            report.results[job] = pipelines[job]->getResult();
+            report.files[job] = pipelines[job]->getStats();
+            --numOpen;
+            if (++numDone == jobs.size())
+                allDone.signal();
+        }
+
+        startFiles();
+    }
+};
+
+std::vector<juce::Result> checkBatchJobs(const std::vector<BatchJob>& jobs)
+{
+    std::vector<juce::Result> checks;
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        auto result = juce::Result::ok();
+
+        for (size_t other = 0; other < jobs.size() && result.wasOk(); ++other) {
+            if (other < i && jobs[other].output == jobs[i].output)
+                result = juce::Result::fail(jobs[i].output.getFullPathName() + " is also the output of " + jobs[other].input.getFullPathName());
+            else if (other != i && jobs[other].input == jobs[i].output)
+                result = juce::Result::fail(jobs[i].output.getFullPathName() + " is also an input");
+        }
+
+        checks.push_back(result);
+    }
+
+    return checks;
+}
+
+BatchReport renderBatch(const std::vector<BatchJob>& jobs, const RenderOptions& options, const BatchOptions& batchOptions)
+{
+    BatchRender batch (jobs, options, batchOptions);
+    return batch.run();
+}
+
+juce::int64 BatchReport::getNumSamples() const
+{
+    juce::int64 numSamples = 0;
+    for (const auto& file : files)
+        numSamples += file.numSamples * file.numChannels;
+    return numSamples;
+}
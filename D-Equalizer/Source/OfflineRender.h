@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    OfflineRender.h
+    Audio files through EQEngine, with no plugin, host or GUI around it.
+
+    A file is read, filtered and written in large blocks, as fast as the disk
+    and the filters go. Channels are split into groups, each through its own
+    engine (and oversampler), so any channel count works: pairs, or single
+    channels when the settings treat every channel the same. Only the IIR
+    path is rendered: linear phase and the crossover stay in the plugin.
+
+    renderFile() does one file on the calling thread. renderBatch() spreads
+    many files over a WorkStealingPool: every file is a pipeline of read,
+    filter and write tasks, one filter task per channel group and block, with
+    a bounded ring of blocks between reader and writer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_dsp/juce_dsp.h>
+#include "EQEngine.h"
+#include "WorkStealingPool.h"
+
+#include <memory>
+#include <vector>
+
+struct RenderOptions
+{
+    ChainSettings settings;
+    int oversamplingOrder = 0;      //the IIR chains run at 1x, 2x or 4x the file's rate
+    int blockSize = 1 << 16;        //samples per channel read, filtered and written at a time
+    int bitsPerSample = 0;          //0 keeps the input's depth when the output format has it
+};
+
+struct RenderStats
+{
+    juce::int64 numSamples = 0;     //per channel
+    int numChannels = 0;
+    double sampleRate = 0.0;
+    double seconds = 0.0;           //wall clock, reading and writing included
+
+    double getRealtimeFactor() const { return seconds > 0.0 ? (double) numSamples / sampleRate / seconds : 0.0; }
+};
+
+//Linked stereo runs the same filters on every channel, so channels go through one
+//engine each; a dynamic band keys off both channels, and the other modes treat them
+//as a pair, so those keep pairs.
+int getChannelGroupSize(const ChainSettings& settings);
+
+//Block 'index' of a render of 'length' samples. The file is filtered in blockSize
+//blocks, followed by 'latency' samples of silence; the first 'latency' samples that
+//come out are dropped, so the output keeps the input's length and timing.
+struct RenderBlock
+{
+    juce::int64 start = 0;          //in samples filtered
+    int numSamples = 0;             //filtered
+    int numToRead = 0;              //from the input, silence after that
+    int numToSkip = 0;              //of the output, before the first one written
+    int numToWrite = 0;
+};
+
+juce::int64 getNumRenderBlocks(juce::int64 length, int latency, int blockSize);
+RenderBlock getRenderBlock(juce::int64 index, juce::int64 length, int latency, int blockSize);
+
+//One or two channels of a file: an engine, and an oversampler around it when asked for.
+class ChannelGroupProcessor
+{
+public:
+    //allocates; numChannels is 1 or 2
+    void prepare(const RenderOptions& options, double sampleRate, int numChannels);
+
+    //in place, up to options.blockSize samples
+    void process(float* const* channels, int numSamples);
+
+    //of the oversampler, in samples at the file's rate
+    int getLatency() const;
+
+private:
+    EQEngine engine;
+    std::unique_ptr<juce::dsp::Oversampling<float>> oversampler;
+    int numChannels = 2;
+    juce::AudioBuffer<float> noSidechain;
+};
+
+//a writer for 'output' in the format its extension names, or nullptr with 'error' set
+std::unique_ptr<juce::AudioFormatWriter> createRenderWriter(juce::AudioFormatManager& formats,
+                                                            const juce::File& output,
+                                                            const juce::AudioFormatReader& source,
+                                                            int bitsPerSample,
+                                                            juce::String& error);
+
+//Renders 'input' to 'output', which is replaced. The output has the input's length, rate
+//and channels, lined up with it: the oversamplers' latency is taken back out. An output
+//that fails part way is deleted.
+juce::Result renderFile(const juce::File& input, const juce::File& output, const RenderOptions& options, RenderStats* stats = nullptr);
+
+//==============================================================================
+struct BatchJob
+{
+    juce::File input, output;
+};
+
+struct BatchOptions
+{
+    int numWorkers = 0;             //0 for one per CPU
+    int queueDepth = 2;             //blocks in flight per file: one read or written while the other is filtered
+    int maxOpenFiles = 0;           //0 for twice the workers; bounds memory and file handles
+};
+
+struct BatchReport
+{
+    std::vector<juce::Result> results;                      //in job order
+    std::vector<RenderStats> files;                         //in job order, seconds from open to close
+    std::vector<WorkStealingPool::WorkerStats> workers;     //work is samples filtered, every channel counted
+    double seconds = 0.0;
+
+    //filtered, every channel counted
+    juce::int64 getNumSamples() const;
+};
+
+//Ok for every job, except one whose output an earlier job already writes to, or that
+//another job reads from: rendering it would clobber a file the batch still needs.
+std::vector<juce::Result> checkBatchJobs(const std::vector<BatchJob>& jobs);
+
+//Renders every job, blocking until all of them are done; jobs checkBatchJobs() fails are
+//left out. Outputs of jobs that fail part way are deleted. Jobs run side by side, and so do
+//the channel groups of a file, so a single long multichannel file also uses every worker.
+BatchReport renderBatch(const std::vector<BatchJob>& jobs, const RenderOptions& options, const BatchOptions& batchOptions);
@@ -0,0 +1,675 @@
+/*
+  ==============================================================================
+
+    ParameterTable.h
+    The parameter tables, without the AudioProcessorValueTreeState.
+
+    Specs, layout order, IDs and defaults of every parameter, plus
+    ParameterValues: plain values in the same shape as ParameterHandles, for
+    code that reads a saved state with no plugin around it (deq-render).
+    Parameters.h builds the plugin's parameters from these tables.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "ChainDesign.h"
+#include "Crossover.h"
+#include "ParametricBands.h"
+
+#include <array>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+enum ParameterKind
+{
+    FloatParameter,
+    ChoiceParameter,
+    BoolParameter
+};
+
+struct ParameterSpec
+{
+    const char* name;
+    ParameterKind kind;
+    float minimum, maximum, interval, skew;     //float parameters only
+    float defaultValue;                         //the index of a choice, 0 or 1 for a bool
+    const char* const* choices;
+    int numChoices;
+};
+
+constexpr ParameterSpec floatParameter(const char* name, float minimum, float maximum, float interval, float skew, float defaultValue)
+{
+    return { name, FloatParameter, minimum, maximum, interval, skew, defaultValue, nullptr, 0 };
+}
+
+template<size_t NumChoices>
+constexpr ParameterSpec choiceParameter(const char* name, const char* const (&choices)[NumChoices], int defaultIndex)
+{
+    return { name, ChoiceParameter, 0.0f, (float) (NumChoices - 1), 1.0f, 1.0f, (float) defaultIndex, choices, (int) NumChoices };
+}
+
+constexpr ParameterSpec boolParameter(const char* name, bool defaultValue)
+{
+    return { name, BoolParameter, 0.0f, 1.0f, 1.0f, 1.0f, defaultValue ? 1.0f : 0.0f, nullptr, 0 };
+}
+
+//==============================================================================
+constexpr const char* slopeChoices[] = { "12 db/Oct", "24 db/Oct", "36 db/Oct", "48 db/Oct", "60 db/Oct", "72 db/Oct", "84 db/Oct", "96 db/Oct" };
+constexpr const char* familyChoices[] = { "Butterworth", "Chebyshev I", "Chebyshev II", "Elliptic" };
+constexpr const char* transitionChoices[] = { "1/2 Oct", "1 Oct", "2 Oct" };
+constexpr const char* attenuationChoices[] = { "48 dB", "72 dB", "96 dB" };
+constexpr const char* topologyChoices[] = { "Biquad", "State Variable" };
+constexpr const char* linearPhaseChoices[] = { "Off", "Low", "Medium", "High" };
+constexpr const char* oversamplingChoices[] = { "Off", "2x", "4x" };
+constexpr const char* channelModeChoices[] = { "Stereo", "Mid/Side", "Left/Right" };
+constexpr const char* crossoverBandChoices[] = { "Off", "2", "3", "4", "5" };
+constexpr const char* crossoverSlopeChoices[] = { "LR 24 dB/Oct", "LR 48 dB/Oct" };
+constexpr const char* snapshotChoices[] = { "A", "B", "C", "D" };
+constexpr const char* bandTypeChoices[] = { "Peak", "Low Shelf", "High Shelf", "Notch", "Tilt" };
+constexpr const char* bandChannelChoices[] = { "Both", "Mid/Left", "Side/Right" };
+
+constexpr size_t numSnapshotSlots = sizeof(snapshotChoices) / sizeof(snapshotChoices[0]);
+
+//parameters that exist once
+enum GlobalParameter
+{
+    Param_LowCutFreq,
+    Param_HighCutFreq,
+    Param_LowCutSlope,
+    Param_HighCutSlope,
+    Param_LowCutBypassed,
+    Param_HighCutBypassed,
+    Param_LowCutType,
+    Param_LowCutTransition,
+    Param_LowCutAttenuation,
+    Param_HighCutType,
+    Param_HighCutTransition,
+    Param_HighCutAttenuation,
+    Param_FilterTopology,
+    Param_LinearPhase,
+    Param_Oversampling,
+    Param_ChannelMode,
+    Param_CrossoverBands,
+    Param_CrossoverSlope,
+    Param_CrossoverFreq1,
+    Param_CrossoverFreq2,
+    Param_CrossoverFreq3,
+    Param_CrossoverFreq4,
+    Param_MorphEnabled,
+    Param_Morph,
+    Param_MorphFrom,
+    Param_MorphTo,
+    NumGlobalParameters
+};
+
+constexpr ParameterSpec globalParameterSpecs[] =
+{
+    floatParameter("LowCut Freq", 20.0f, 20000.0f, 1.0f, 0.25f, 20.0f),
+    floatParameter("HighCut Freq", 20.0f, 20000.0f, 1.0f, 0.25f, 20000.0f),
+    choiceParameter("LowCut Slope", slopeChoices, 0),
+    choiceParameter("HighCut Slope", slopeChoices, 0),
+    boolParameter("LowCut Bypassed", false),
+    boolParameter("HighCut Bypassed", false),
+    choiceParameter("LowCut Type", familyChoices, 0),
+    choiceParameter("LowCut Transition", transitionChoices, 1),
+    choiceParameter("LowCut Attenuation", attenuationChoices, 1),
+    choiceParameter("HighCut Type", familyChoices, 0),
+    choiceParameter("HighCut Transition", transitionChoices, 1),
+    choiceParameter("HighCut Attenuation", attenuationChoices, 1),
+    choiceParameter("Filter Topology", topologyChoices, 0),
+    choiceParameter("Linear Phase", linearPhaseChoices, 0),
+    choiceParameter("Oversampling", oversamplingChoices, 0),
+    choiceParameter("Channel Mode", channelModeChoices, 0),
+    choiceParameter("Crossover Bands", crossoverBandChoices, 0),
+    choiceParameter("Crossover Slope", crossoverSlopeChoices, 0),
+    floatParameter("Crossover Freq 1", 20.0f, 20000.0f, 1.0f, 0.25f, 120.0f),
+    floatParameter("Crossover Freq 2", 20.0f, 20000.0f, 1.0f, 0.25f, 500.0f),
+    floatParameter("Crossover Freq 3", 20.0f, 20000.0f, 1.0f, 0.25f, 2000.0f),
+    floatParameter("Crossover Freq 4", 20.0f, 20000.0f, 1.0f, 0.25f, 6000.0f),
+    boolParameter("Morph Enabled", false),
+    floatParameter("Morph", 0.0f, 1.0f, 0.001f, 1.0f, 0.0f),
+    choiceParameter("Morph From", snapshotChoices, 0),
+    choiceParameter("Morph To", snapshotChoices, 1)
+};
+
+static_assert(sizeof(globalParameterSpecs) / sizeof(ParameterSpec) == NumGlobalParameters, "one spec per global parameter");
+
+//parameters of each of the maxBands EQ bands
+enum BandParameter
+{
+    BandParam_Freq,
+    BandParam_Gain,
+    BandParam_Quality,
+    BandParam_Type,
+    BandParam_Bypassed,
+    BandParam_Dynamic,
+    BandParam_Threshold,
+    BandParam_Ratio,
+    BandParam_Attack,
+    BandParam_Release,
+    BandParam_Channel,
+    NumBandParameters
+};
+
+constexpr ParameterSpec bandParameterSpecs[] =
+{
+    floatParameter("Freq", 20.0f, 20000.0f, 1.0f, 0.25f, 750.0f),
+    floatParameter("Gain", -24.0f, 24.0f, 0.5f, 1.0f, 0.0f),
+    floatParameter("Quality", 0.1f, 10.0f, 0.05f, 1.0f, 1.0f),
+    choiceParameter("Type", bandTypeChoices, 0),
+    boolParameter("Bypassed", true),
+    boolParameter("Dynamic", false),
+    floatParameter("Threshold", -60.0f, 0.0f, 0.5f, 1.0f, -24.0f),
+    floatParameter("Ratio", 1.0f, 20.0f, 0.1f, 0.4f, 2.0f),
+    floatParameter("Attack", 0.5f, 200.0f, 0.1f, 0.4f, 10.0f),
+    floatParameter("Release", 5.0f, 2000.0f, 1.0f, 0.4f, 150.0f),
+    choiceParameter("Channel", bandChannelChoices, 0)
+};
+
+static_assert(sizeof(bandParameterSpecs) / sizeof(ParameterSpec) == NumBandParameters, "one spec per band parameter");
+
+//parameters of each of the maxCrossoverBands crossover bands
+enum CrossoverBandParameter
+{
+    CrossoverParam_Gain,
+    CrossoverParam_Mute,
+    CrossoverParam_Solo,
+    NumCrossoverBandParameters
+};
+
+constexpr ParameterSpec crossoverBandParameterSpecs[] =
+{
+    floatParameter("Gain", -24.0f, 24.0f, 0.5f, 1.0f, 0.0f),
+    boolParameter("Mute", false),
+    boolParameter("Solo", false)
+};
+
+static_assert(sizeof(crossoverBandParameterSpecs) / sizeof(ParameterSpec) == NumCrossoverBandParameters, "one spec per crossover band parameter");
+
+//==============================================================================
+enum ParameterGroup
+{
+    GlobalGroup,
+    BandGroup,
+    CrossoverBandGroup
+};
+
+//parameters first to last of a group; for the per-band groups, for bands firstBand to
+//lastBand - 1, band after band
+struct ParameterLayoutRow
+{
+    ParameterGroup group;
+    int first, last;
+    size_t firstBand, lastBand;
+};
+
+//the order parameters were introduced in; band 1 is the old single peak filter
+constexpr ParameterLayoutRow parameterLayout[] =
+{
+    { GlobalGroup, Param_LowCutFreq, Param_HighCutFreq, 0, 0 },
+    { BandGroup, BandParam_Freq, BandParam_Quality, 0, 1 },
+    { GlobalGroup, Param_LowCutSlope, Param_LowCutBypassed, 0, 0 },
+    { BandGroup, BandParam_Bypassed, BandParam_Bypassed, 0, 1 },
+    { GlobalGroup, Param_HighCutBypassed, Param_FilterTopology, 0, 0 },
+    { BandGroup, BandParam_Type, BandParam_Type, 0, 1 },
+    { BandGroup, BandParam_Freq, BandParam_Bypassed, 1, maxBands },
+    { BandGroup, BandParam_Dynamic, BandParam_Release, 0, maxBands },
+    { GlobalGroup, Param_LinearPhase, Param_ChannelMode, 0, 0 },
+    { BandGroup, BandParam_Channel, BandParam_Channel, 0, maxBands },
+    { GlobalGroup, Param_CrossoverBands, Param_CrossoverFreq4, 0, 0 },
+    { CrossoverBandGroup, CrossoverParam_Gain, CrossoverParam_Solo, 0, maxCrossoverBands },
+    { GlobalGroup, Param_MorphEnabled, Param_MorphTo, 0, 0 }
+};
+
+constexpr size_t countLayoutParameters()
+{
+    size_t count = 0;
+    for( const auto& row : parameterLayout )
+        count += (size_t) (row.last - row.first + 1) * (row.group == GlobalGroup ? 1 : row.lastBand - row.firstBand);
+    return count;
+}
+
+static_assert(countLayoutParameters() == NumGlobalParameters + maxBands * NumBandParameters + maxCrossoverBands * NumCrossoverBandParameters,
+              "every parameter appears in the layout exactly once");
+
+//==============================================================================
+inline juce::String getParameterID(GlobalParameter parameter)
+{
+    return globalParameterSpecs[parameter].name;
+}
+
+//Band 1 keeps the IDs of the old single peak ("Peak Freq", ...), the others are "Band 2 Freq" etc.
+inline juce::String getBandParameterID(size_t band, BandParameter parameter)
+{
+    return (band == 0 ? juce::String("Peak ") : "Band " + juce::String((int) band + 1) + " ") + bandParameterSpecs[parameter].name;
+}
+
+inline juce::String getCrossoverBandParameterID(size_t band, CrossoverBandParameter parameter)
+{
+    return "Crossover Band " + juce::String((int) band + 1) + " " + crossoverBandParameterSpecs[parameter].name;
+}
+
+//band 1 starts enabled, the others start bypassed and spread from 40 Hz to 16 kHz
+inline float getBandParameterDefault(size_t band, BandParameter parameter)
+{
+    if( band == 0 && parameter == BandParam_Bypassed )
+        return 0.0f;
+
+    if( band > 0 && parameter == BandParam_Freq )
+        return (float) juce::roundToInt(40.0f * std::pow(400.0f, (float) (band - 1) / (float) (maxBands - 2)));
+
+    return bandParameterSpecs[parameter].defaultValue;
+}
+//==============================================================================
+//The plugin's saved state: 'DEQB', the format version, the number of values, then the
+//value of every parameter in parameterLayout order (the host's order).
+//Version 2 follows them with the filled snapshot slots: their count, then for each the
+//slot index and a writeChainSettings() record, prefixed by its size in bytes.
+//Version 3 stores plain values where the older ones stored normalised ones, so a later
+//change to a parameter's range or skew no longer moves what a saved session holds.
+constexpr int binaryStateMagic = 0x42514544;   //"DEQB" in little-endian byte order
+constexpr int binaryStateVersion = 3;
+
+inline bool isKnownBinaryStateVersion(int version)
+{
+    return version >= 1 && version <= binaryStateVersion;
+}
+
+inline bool storesPlainValues(int version)
+{
+    return version >= 3;
+}
+
+//every field of 'settings', bands first, led by the number of bands
+inline void writeChainSettings(juce::OutputStream& out, const ChainSettings& settings)
+{
+    out.writeInt((int) settings.bands.size());
+    
+    for( const auto& band : settings.bands )
+    {
+        out.writeFloat(band.freq);
+        out.writeFloat(band.gainDb);
+        out.writeFloat(band.quality);
+        out.writeInt((int) band.type);
+        out.writeBool(band.bypassed);
+        out.writeInt((int) band.channel);
+        out.writeBool(band.dynamic);
+        out.writeFloat(band.thresholdDb);
+        out.writeFloat(band.ratio);
+        out.writeFloat(band.attackMs);
+        out.writeFloat(band.releaseMs);
+    }
+    
+    out.writeFloat(settings.lowCutFreq);
+    out.writeFloat(settings.highCutFreq);
+    out.writeInt((int) settings.lowCutSlope);
+    out.writeInt((int) settings.highCutSlope);
+    
+    for( const auto* shape : { &settings.lowCutShape, &settings.highCutShape } )
+    {
+        out.writeInt((int) shape->family);
+        out.writeInt((int) shape->transition);
+        out.writeInt((int) shape->attenuation);
+    }
+    
+    out.writeBool(settings.lowCutBypassed);
+    out.writeBool(settings.highCutBypassed);
+    out.writeInt((int) settings.topology);
+    out.writeInt((int) settings.channelMode);
+}
+
+//true if 'value' is one a parameter of this spec can hold: finite and inside its range,
+//and for choices and bools a whole index
+inline bool isWithinRange(const ParameterSpec& spec, float value)
+{
+    if( ! std::isfinite(value) || value < spec.minimum || value > spec.maximum )
+        return false;
+    
+    return spec.kind == FloatParameter || value == std::floor(value);
+}
+
+//what writeChainSettings() wrote; bands a record does not have keep their defaults.
+//false, with 'settings' left at its defaults, if the record is cut short or any field is
+//outside the range of the parameter it comes from - a broken blob must not reach the
+//filter design as an out of range enum or a zero frequency.
+inline bool readChainSettings(juce::InputStream& in, ChainSettings& settings)
+{
+    //bytes per band, and after the bands, as writeChainSettings() writes them
+    constexpr juce::int64 bandSize = 7 * sizeof(float) + 2 * sizeof(int) + 2;
+    constexpr juce::int64 tailSize = 2 * sizeof(float) + 10 * sizeof(int) + 2;
+    
+    settings = ChainSettings();
+    const auto numBands = in.readInt();
+    
+    if( numBands < 0 || in.getNumBytesRemaining() < numBands * bandSize + tailSize )
+        return false;
+    
+    auto valid = true;
+    
+    auto readFloat = [&in, &valid](const ParameterSpec& spec)
+    {
+        const auto value = in.readFloat();
+        valid = valid && isWithinRange(spec, value);
+        return value;
+    };
+    
+    //a choice index, 0 if it is not one of the choices
+    auto readIndex = [&in, &valid](const ParameterSpec& spec)
+    {
+        const auto index = in.readInt();
+        const auto isChoice = index >= 0 && index < spec.numChoices;
+        valid = valid && isChoice;
+        return isChoice ? index : 0;
+    };
+    
+    ChainSettings read;
+    
+    for( int i = 0; i < numBands; ++i )
+    {
+        BandSettings band;
+        band.freq = readFloat(bandParameterSpecs[BandParam_Freq]);
+        band.gainDb = readFloat(bandParameterSpecs[BandParam_Gain]);
+        band.quality = readFloat(bandParameterSpecs[BandParam_Quality]);
+        band.type = static_cast<BandType>(readIndex(bandParameterSpecs[BandParam_Type]));
+        band.bypassed = in.readBool();
+        band.channel = static_cast<BandChannel>(readIndex(bandParameterSpecs[BandParam_Channel]));
+        band.dynamic = in.readBool();
+        band.thresholdDb = readFloat(bandParameterSpecs[BandParam_Threshold]);
+        band.ratio = readFloat(bandParameterSpecs[BandParam_Ratio]);
+        band.attackMs = readFloat(bandParameterSpecs[BandParam_Attack]);
+        band.releaseMs = readFloat(bandParameterSpecs[BandParam_Release]);
+        
+        if( i < (int) read.bands.size() )
+            read.bands[(size_t) i] = band;
+    }
+    
+    read.lowCutFreq = readFloat(globalParameterSpecs[Param_LowCutFreq]);
+    read.highCutFreq = readFloat(globalParameterSpecs[Param_HighCutFreq]);
+    read.lowCutSlope = static_cast<Slope>(readIndex(globalParameterSpecs[Param_LowCutSlope]));
+    read.highCutSlope = static_cast<Slope>(readIndex(globalParameterSpecs[Param_HighCutSlope]));
+    
+    //the type, transition and attenuation parameters of a cut follow one another
+    for( auto shape : { std::make_pair(&read.lowCutShape, Param_LowCutType), std::make_pair(&read.highCutShape, Param_HighCutType) } )
+    {
+        shape.first->family = static_cast<CutFamily>(readIndex(globalParameterSpecs[shape.second]));
+        shape.first->transition = static_cast<CutTransition>(readIndex(globalParameterSpecs[shape.second + 1]));
+        shape.first->attenuation = static_cast<CutAttenuation>(readIndex(globalParameterSpecs[shape.second + 2]));
+    }
+    
+    read.lowCutBypassed = in.readBool();
+    read.highCutBypassed = in.readBool();
+    read.topology = static_cast<FilterTopology>(readIndex(globalParameterSpecs[Param_FilterTopology]));
+    read.channelMode = static_cast<ChannelMode>(readIndex(globalParameterSpecs[Param_ChannelMode]));
+    
+    if( ! valid )
+        return false;
+    
+    settings = read;
+    return true;
+}
+
+//the snapshot records of a version 2 blob, 'in' just past its parameter values; a slot
+//no record fills is left unfilled. false if a record is cut short, names no slot or does
+//not pass readChainSettings(): the caller then loads nothing of the blob.
+inline bool readSnapshotRecords(juce::MemoryInputStream& in,
+                                std::array<ChainSettings, numSnapshotSlots>& snapshots,
+                                std::array<bool, numSnapshotSlots>& filled)
+{
+    filled.fill(false);
+    const auto numRecords = in.readInt();
+    
+    for( int i = 0; i < numRecords; ++i )
+    {
+        const auto slot = in.readInt();
+        const auto recordSize = in.readInt();
+        const auto next = in.getPosition() + recordSize;
+        
+        if( slot < 0 || slot >= (int) numSnapshotSlots || recordSize < 0 || next > in.getTotalLength() )
+            return false;
+        
+        juce::MemoryInputStream record(static_cast<const char*>(in.getData()) + in.getPosition(), (size_t) recordSize, false);
+        if( ! readChainSettings(record, snapshots[(size_t) slot]) )
+            return false;
+        
+        filled[(size_t) slot] = true;
+        in.setPosition(next);
+    }
+    
+    return true;
+}
+
+//the value a parameter of this spec holds for a normalised one, as the plugin would read it
+inline float convertFromNormalised(const ParameterSpec& spec, float normalised)
+{
+    normalised = juce::jlimit(0.0f, 1.0f, normalised);
+    
+    switch( spec.kind )
+    {
+        case ChoiceParameter:
+            return (float) juce::roundToInt(normalised * (float) (spec.numChoices - 1));
+        case BoolParameter:
+            return normalised >= 0.5f ? 1.0f : 0.0f;
+        case FloatParameter:
+        default:
+            return juce::NormalisableRange<float>(spec.minimum, spec.maximum, spec.interval, spec.skew).convertFrom0to1(normalised);
+    }
+}
+
+/*
+ Plain values of every parameter, all at their defaults to begin with. Reads what the plugin
+ writes: its binary state, or the XML of its ValueTree (PARAM elements with id and value,
+ as copyState().createXml() saves a preset). Same get() and isOn() as ParameterHandles, so
+ getChainSettings reads either.
+ */
+class ParameterValues
+{
+public:
+    ParameterValues()
+    {
+        forEachParameter([](const ParameterSpec&, const juce::String&, float defaultValue, float& value) { value = defaultValue; });
+    }
+    
+    float get(GlobalParameter parameter) const { return global[parameter]; }
+    float get(size_t band, BandParameter parameter) const { return bands[band][parameter]; }
+    float get(size_t band, CrossoverBandParameter parameter) const { return crossoverBands[band][parameter]; }
+    
+    bool isOn(GlobalParameter parameter) const { return get(parameter) > 0.5f; }
+    bool isOn(size_t band, BandParameter parameter) const { return get(band, parameter) > 0.5f; }
+    bool isOn(size_t band, CrossoverBandParameter parameter) const { return get(band, parameter) > 0.5f; }
+    
+    //a plain value by parameter ID, clamped to its range; false for an unknown ID
+    bool set(const juce::String& id, float plainValue)
+    {
+        bool found = false;
+        forEachParameter([&](const ParameterSpec& spec, const juce::String& parameterID, float, float& value)
+        {
+            if( ! found && parameterID == id )
+            {
+                value = juce::jlimit(spec.minimum, spec.maximum, plainValue);
+                found = true;
+            }
+        });
+        return found;
+    }
+    
+    //a snapshot slot of the loaded binary state; false, leaving 'settings' alone, while
+    //the slot is empty. Only binary states from version 2 on hold snapshots.
+    bool readSnapshot(size_t slot, ChainSettings& settings) const
+    {
+        if( ! filled[slot] )
+            return false;
+        
+        settings = snapshots[slot];
+        return true;
+    }
+    
+    //false for anything that is not a binary state of a known version; parameters the
+    //state predates go back to their defaults, and slots it does not fill are empty,
+    //as they are in the plugin
+    bool loadBinaryState(const void* data, int sizeInBytes)
+    {
+        constexpr int headerSize = 3 * sizeof(int);
+        
+        if( data == nullptr || sizeInBytes < headerSize )
+            return false;
+        
+        juce::MemoryInputStream mis(data, (size_t) sizeInBytes, false);
+        
+        if( mis.readInt() != binaryStateMagic )
+            return false;
+        
+        const auto version = mis.readInt();
+        if( ! isKnownBinaryStateVersion(version) )
+            return false;
+        
+        const auto numStored = juce::jlimit(0, (sizeInBytes - headerSize) / (int) sizeof(float), mis.readInt());
+        const auto plain = storesPlainValues(version);
+        
+        //the plugin refuses a value outside its parameter's range, and so does this
+        ParameterValues loaded;
+        auto valid = true;
+        int index = 0;
+        
+        loaded.forEachParameter([&](const ParameterSpec& spec, const juce::String&, float, float& value)
+        {
+            if( index++ >= numStored )
+                return;
+            
+            const auto stored = mis.readFloat();
+            valid = valid && (plain ? isWithinRange(spec, stored) : stored >= 0.0f && stored <= 1.0f);
+            value = plain ? stored : convertFromNormalised(spec, stored);
+        });
+        
+        //past the values of parameters this build no longer has
+        mis.setPosition(headerSize + (juce::int64) numStored * (juce::int64) sizeof(float));
+        
+        //the plugin refuses a blob with a broken snapshot record, and so does this
+        if( ! valid || (version >= 2 && ! readSnapshotRecords(mis, loaded.snapshots, loaded.filled)) )
+            return false;
+        
+        *this = loaded;
+        return true;
+    }
+    
+    //the PARAM children of 'state'; values it does not mention are left alone.
+    //false if none of them named a parameter.
+    bool loadXmlState(const juce::XmlElement& state)
+    {
+        bool found = false;
+        
+        for( auto* element : state.getChildWithTagNameIterator("PARAM") )
+            found = set(element->getStringAttribute("id"), (float) element->getDoubleAttribute("value")) || found;
+        
+        return found;
+    }
+    
+private:
+    std::array<float, NumGlobalParameters> global {};
+    std::array<std::array<float, NumBandParameters>, maxBands> bands {};
+    std::array<std::array<float, NumCrossoverBandParameters>, maxCrossoverBands> crossoverBands {};
+    
+    std::array<ChainSettings, numSnapshotSlots> snapshots;
+    std::array<bool, numSnapshotSlots> filled {};
+    
+    //visit(spec, id, defaultValue, value) for every parameter, in parameterLayout order
+    template<typename Visitor>
+    void forEachParameter(Visitor&& visit)
+    {
+        for( const auto& row : parameterLayout )
+        {
+            if( row.group == GlobalGroup )
+            {
+                for( int p = row.first; p <= row.last; ++p )
+                    visit(globalParameterSpecs[p], getParameterID(static_cast<GlobalParameter>(p)),
+                          globalParameterSpecs[p].defaultValue, global[(size_t) p]);
+                continue;
+            }
+            
+            for( size_t band = row.firstBand; band < row.lastBand; ++band )
+            {
+                for( int p = row.first; p <= row.last; ++p )
+                {
+                    if( row.group == BandGroup )
+                    {
+                        const auto parameter = static_cast<BandParameter>(p);
+                        visit(bandParameterSpecs[p], getBandParameterID(band, parameter),
+                              getBandParameterDefault(band, parameter), bands[band][(size_t) p]);
+                    }
+                    else
+                    {
+                        visit(crossoverBandParameterSpecs[p], getCrossoverBandParameterID(band, static_cast<CrossoverBandParameter>(p)),
+                              crossoverBandParameterSpecs[p].defaultValue, crossoverBands[band][(size_t) p]);
+                    }
+                }
+            }
+        }
+    }
+};
+
+//==============================================================================
+//ParameterHandles on the audio thread, where it runs on every grid point, or ParameterValues
+template<typename ParameterSource>
+ChainSettings getChainSettings(const ParameterSource& parameters)
+{
+    ChainSettings settings;
+    
+    settings.lowCutFreq = parameters.get(Param_LowCutFreq);
+    settings.highCutFreq = parameters.get(Param_HighCutFreq);
+    settings.lowCutSlope = static_cast<Slope>(parameters.get(Param_LowCutSlope));
+    settings.highCutSlope = static_cast<Slope>(parameters.get(Param_HighCutSlope));
+    
+    settings.lowCutShape.family = static_cast<CutFamily>(parameters.get(Param_LowCutType));
+    settings.lowCutShape.transition = static_cast<CutTransition>(parameters.get(Param_LowCutTransition));
+    settings.lowCutShape.attenuation = static_cast<CutAttenuation>(parameters.get(Param_LowCutAttenuation));
+    settings.highCutShape.family = static_cast<CutFamily>(parameters.get(Param_HighCutType));
+    settings.highCutShape.transition = static_cast<CutTransition>(parameters.get(Param_HighCutTransition));
+    settings.highCutShape.attenuation = static_cast<CutAttenuation>(parameters.get(Param_HighCutAttenuation));
+    
+    settings.lowCutBypassed = parameters.isOn(Param_LowCutBypassed);
+    settings.highCutBypassed = parameters.isOn(Param_HighCutBypassed);
+    
+    for( size_t band = 0; band < maxBands; ++band )
+    {
+        auto& bandSettings = settings.bands[band];
+        bandSettings.freq = parameters.get(band, BandParam_Freq);
+        bandSettings.gainDb = parameters.get(band, BandParam_Gain);
+        bandSettings.quality = parameters.get(band, BandParam_Quality);
+        bandSettings.type = static_cast<BandType>(parameters.get(band, BandParam_Type));
+        bandSettings.bypassed = parameters.isOn(band, BandParam_Bypassed);
+        bandSettings.channel = static_cast<BandChannel>(parameters.get(band, BandParam_Channel));
+        bandSettings.dynamic = parameters.isOn(band, BandParam_Dynamic);
+        bandSettings.thresholdDb = parameters.get(band, BandParam_Threshold);
+        bandSettings.ratio = parameters.get(band, BandParam_Ratio);
+        bandSettings.attackMs = parameters.get(band, BandParam_Attack);
+        bandSettings.releaseMs = parameters.get(band, BandParam_Release);
+    }
+    
+    settings.topology = static_cast<FilterTopology>(parameters.get(Param_FilterTopology));
+    settings.channelMode = static_cast<ChannelMode>(parameters.get(Param_ChannelMode));
+    
+    return settings;
+}
+
+//What the chains are designed from: the parameters, or with Morph Enabled the point
+//between the Morph From and Morph To snapshots that Morph picks. readSnapshot(slot,
+//settings) fills in a slot and returns false for an empty one, which stands for the
+//current parameters. The plugin's getTargetSettings() and deq-render share this.
+template<typename ParameterSource, typename SnapshotReader>
+ChainSettings getTargetChainSettings(const ParameterSource& parameters, SnapshotReader&& readSnapshot)
+{
+    const auto current = getChainSettings(parameters);
+    
+    if( ! parameters.isOn(Param_MorphEnabled) )
+        return current;
+    
+    auto from = current;
+    auto to = current;
+    readSnapshot((size_t) parameters.get(Param_MorphFrom), from);
+    readSnapshot((size_t) parameters.get(Param_MorphTo), to);
+    
+    return morphChainSettings(from, to, parameters.get(Param_Morph));
+}
@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    Parameters.h
+    Every parameter of the plugin, described once.
+
+    The spec tables in ParameterTable.h give each parameter its name, range
+    and default. parameterLayout lists them in the order they are added to
+    the AudioProcessorValueTreeState; that order is the host's parameter
+    index, so new parameters only ever go at its end. ParameterHandles looks
+    every raw value up once, and after that a setting is read by array index,
+    with no hashing and no string compares.
+
+    A new per-band parameter is an enum value, a spec and a layout row.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ParameterTable.h"
+
+#include <array>
+#include <memory>
+
+inline std::unique_ptr<juce::RangedAudioParameter> makeParameter(const ParameterSpec& spec, const juce::String& id, float defaultValue)
+{
+    switch( spec.kind )
+    {
+        case ChoiceParameter:
+        {
+            juce::StringArray choices;
+            for( int i = 0; i < spec.numChoices; ++i )
+                choices.add(spec.choices[i]);
+            return std::make_unique<juce::AudioParameterChoice>(id, id, choices, (int) defaultValue);
+        }
+        case BoolParameter:
+            return std::make_unique<juce::AudioParameterBool>(id, id, defaultValue > 0.5f);
+        case FloatParameter:
+        default:
+            return std::make_unique<juce::AudioParameterFloat>(id, id,
+                                                               juce::NormalisableRange<float>(spec.minimum, spec.maximum, spec.interval, spec.skew),
+                                                               defaultValue);
+    }
+}
+
+inline juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayoutFromTable()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    for( const auto& row : parameterLayout )
+    {
+        if( row.group == GlobalGroup )
+        {
+            for( int p = row.first; p <= row.last; ++p )
+                layout.add(makeParameter(globalParameterSpecs[p], getParameterID(static_cast<GlobalParameter>(p)),
+                                         globalParameterSpecs[p].defaultValue));
+            continue;
+        }
+
+        for( size_t band = row.firstBand; band < row.lastBand; ++band )
+        {
+            for( int p = row.first; p <= row.last; ++p )
+            {
+                if( row.group == BandGroup )
+                {
+                    const auto parameter = static_cast<BandParameter>(p);
+                    layout.add(makeParameter(bandParameterSpecs[p], getBandParameterID(band, parameter),
+                                             getBandParameterDefault(band, parameter)));
+                }
+                else
+                {
+                    layout.add(makeParameter(crossoverBandParameterSpecs[p], getCrossoverBandParameterID(band, static_cast<CrossoverBandParameter>(p)),
+                                             crossoverBandParameterSpecs[p].defaultValue));
+                }
+            }
+        }
+    }
+
+    return layout;
+}
+
+//==============================================================================
+//the raw values of every parameter, looked up once
+struct ParameterHandles
+{
+    explicit ParameterHandles(juce::AudioProcessorValueTreeState& apvts)
+    {
+        for( int p = 0; p < NumGlobalParameters; ++p )
+            global[(size_t) p] = apvts.getRawParameterValue(getParameterID(static_cast<GlobalParameter>(p)));
+
+        for( size_t band = 0; band < maxBands; ++band )
+            for( int p = 0; p < NumBandParameters; ++p )
+                bands[band][(size_t) p] = apvts.getRawParameterValue(getBandParameterID(band, static_cast<BandParameter>(p)));
+
+        for( size_t band = 0; band < maxCrossoverBands; ++band )
+            for( int p = 0; p < NumCrossoverBandParameters; ++p )
+                crossoverBands[band][(size_t) p] = apvts.getRawParameterValue(getCrossoverBandParameterID(band, static_cast<CrossoverBandParameter>(p)));
+    }
+
+    float get(GlobalParameter parameter) const { return global[parameter]->load(); }
+    float get(size_t band, BandParameter parameter) const { return bands[band][parameter]->load(); }
+    float get(size_t band, CrossoverBandParameter parameter) const { return crossoverBands[band][parameter]->load(); }
+
+    bool isOn(GlobalParameter parameter) const { return get(parameter) > 0.5f; }
+    bool isOn(size_t band, BandParameter parameter) const { return get(band, parameter) > 0.5f; }
+    bool isOn(size_t band, CrossoverBandParameter parameter) const { return get(band, parameter) > 0.5f; }
+
+private:
+    std::array<std::atomic<float>*, NumGlobalParameters> global {};
+    std::array<std::array<std::atomic<float>*, NumBandParameters>, maxBands> bands {};
+    std::array<std::array<std::atomic<float>*, NumCrossoverBandParameters>, maxCrossoverBands> crossoverBands {};
+};
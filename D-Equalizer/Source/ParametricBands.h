@@ -0,0 +1,139 @@
+/*
+  ==============================================================================
+
+    ParametricBands.h
+    The parametric stage of the EQ chains: up to maxBands peak, shelf, notch
+    and tilt bands per channel, all allocated up front.
+
+    Only the enabled bands are run. Their indices are packed into a short
+    list whenever the band layout changes, so a stage with three bands in use
+    costs three sections no matter how many are available.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+#include <array>
+
+constexpr size_t maxBands = 24;
+
+enum BandType
+{
+    PeakBand,
+    LowShelfBand,
+    HighShelfBand,
+    NotchBand,
+    TiltBand    //gainDb is the span between the lows and the highs, pivoting at freq
+};
+
+//the path of an unlinked chain a band runs on; a linked chain runs every band on both
+enum BandChannel
+{
+    BothChannels,
+    FirstChannel,   //mid, or left
+    SecondChannel   //side, or right
+};
+
+struct BandSettings
+{
+    float freq {750.0f}, gainDb {0.0f}, quality {1.0f};
+    BandType type {BandType::PeakBand};
+    bool bypassed {true};
+    BandChannel channel {BandChannel::BothChannels};
+
+    //dynamic EQ, see BandDynamics
+    bool dynamic {false};
+    float thresholdDb {-24.0f}, ratio {2.0f}, attackMs {10.0f}, releaseMs {150.0f};
+};
+
+using BandArray = std::array<BandSettings, maxBands>;
+
+inline bool operator==(const BandSettings& a, const BandSettings& b)
+{
+    return a.freq == b.freq && a.gainDb == b.gainDb && a.quality == b.quality
+        && a.type == b.type && a.bypassed == b.bypassed && a.channel == b.channel
+        && a.dynamic == b.dynamic && a.thresholdDb == b.thresholdDb && a.ratio == b.ratio
+        && a.attackMs == b.attackMs && a.releaseMs == b.releaseMs;
+}
+
+//true when the same bands are enabled, with the same types, on the same channels
+inline bool haveSameLayout(const BandArray& a, const BandArray& b)
+{
+    for( size_t i = 0; i < maxBands; ++i )
+        if( a[i].bypassed != b[i].bypassed
+           || (! a[i].bypassed && (a[i].type != b[i].type || a[i].channel != b[i].channel)) )
+            return false;
+
+    return true;
+}
+
+inline bool allBandsBypassed(const BandArray& bands)
+{
+    for( const auto& band : bands )
+        if( ! band.bypassed )
+            return false;
+
+    return true;
+}
+
+template<typename SectionType>
+class ParametricBands
+{
+public:
+    SectionType& getBand(size_t index) { return bands[index]; }
+    const SectionType& getBand(size_t index) const { return bands[index]; }
+
+    size_t getNumActiveBands() const { return numActive; }
+
+    //index of the i-th enabled band
+    size_t getActiveBand(size_t i) const { return active[i]; }
+
+    //packs the enabled bands in order; cheap enough for the audio thread
+    void setActiveBands(const BandArray& settings)
+    {
+        setActiveBands(settings, 0, true);
+    }
+
+    //the same for one path (0 or 1) of a chain: unlinked, it skips the other path's bands
+    void setActiveBands(const BandArray& settings, size_t channel, bool linked)
+    {
+        numActive = 0;
+        for( size_t i = 0; i < maxBands; ++i )
+            if( ! settings[i].bypassed
+               && (linked || settings[i].channel == BothChannels || (size_t) settings[i].channel == channel + 1) )
+                active[numActive++] = i;
+    }
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        for( auto& band : bands )
+            band.prepare(spec);
+    }
+
+    void reset()
+    {
+        for( auto& band : bands )
+            band.reset();
+    }
+
+    //processes in place, one enabled band after the other
+    template<typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        jassert(! context.usesSeparateInputAndOutputBlocks());
+
+        if( context.isBypassed )
+            return;
+
+        for( size_t i = 0; i < numActive; ++i )
+            bands[active[i]].process(context);
+    }
+
+private:
+    std::array<SectionType, maxBands> bands;
+    std::array<size_t, maxBands> active {};
+    size_t numActive = 0;
+};
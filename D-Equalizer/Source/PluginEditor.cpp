@@ -14,8 +14,7 @@
 ResponseCurveComponent::ResponseCurveComponent(EQAudioProcessor& p) :
 audioProcessor(p),
 
-leftPathProducer(audioProcessor.leftChannelFifo),
-rightPathProducer(audioProcessor.rightChannelFifo)
+pathProducer(audioProcessor.analyzerRing)
 
 {
     const auto& params = audioProcessor.getParameters();
@@ -41,45 +40,63 @@ void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float new
     parametersChanged.set(true);
 }
 
-void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
+void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate, juce::uint32 activeLanes)
 {
-    juce::AudioBuffer<float> tempIncomingBuffer;
+    const int maxFramesPerPull = 4096;
+    incomingFrames.resize(maxFramesPerPull * NumAnalyzerLanes);
     
-    while (leftChannelFifo->getNumCompleteBuffersAvailable() > 0) {
-        if (leftChannelFifo->getAudioBuffer(tempIncomingBuffer)) {
-            auto size = tempIncomingBuffer.getNumSamples();
-            
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                                              monoBuffer.getReadPointer(0, size),
-                                              monoBuffer.getNumSamples() - size);
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-                                              tempIncomingBuffer.getReadPointer(0, 0),
-                                              size);
-            
-            leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.0f);
-        }
+    int numFrames = 0;
+    while ((numFrames = analyzerRing->pull(incomingFrames.data(), maxFramesPerPull)) > 0) {
+        fftDataGenerator.pushFrames(incomingFrames.data(), numFrames, activeLanes, -48.0f);
     }
     
     // if there are FFT data buffers to pull
         // if we can bull a buffer
-            // generate a path
+            // generate a path for every active lane
     
-    const auto fftSize = leftChannelFFTDataGenerator.getFFTSize();
-    const auto binWidth = sampleRate / (double) fftSize;
+    const auto& normalizedFrequencies = fftDataGenerator.getNormalizedFrequencies();
+    const auto numPoints = normalizedFrequencies.size();
+    const auto preEqActive = (activeLanes & (1u << AnalyzerLane::PreLeft)) != 0;
     
-    while (leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0) {
+    while (fftDataGenerator.getNumAvailableFFTDataBlocks() > 0) {
         std::vector<float> fftData;
-        if (leftChannelFFTDataGenerator.getFFTData(fftData)) {
-            pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.0f);
+        if (fftDataGenerator.getFFTData(fftData)) {
+            for (int lane = 0; lane < NumAnalyzerLanes; ++lane) {
+                if ((activeLanes & (1u << lane)) == 0)
+                    continue;
+                
+                auto laneStart = fftData.begin() + lane * numPoints;
+                laneSpectrum.assign(laneStart, laneStart + numPoints);
+                pathGenerators[lane].generatePath(laneSpectrum, normalizedFrequencies, fftBounds, sampleRate, -48.0f);
+            }
+            
+            if (preEqActive) {
+                differenceSpectrum.resize(numPoints);
+                for (size_t i = 0; i < numPoints; ++i) {
+                    auto left = fftData[AnalyzerLane::PostLeft * numPoints + i] - fftData[AnalyzerLane::PreLeft * numPoints + i];
+                    auto right = fftData[AnalyzerLane::PostRight * numPoints + i] - fftData[AnalyzerLane::PreRight * numPoints + i];
+                    differenceSpectrum[i] = 0.5f * (left + right);
+                }
+            }
         }
     }
     
+    if (!preEqActive)
+        differenceSpectrum.clear();
+    
     // while there are paths that can be pull
         // pull as many as we can
             // display the most recent path
     
-    while (pathProducer.getNumPathsAvailable()) {
-        pathProducer.getPath(leftChannelFFTPath);
+    for (int lane = 0; lane < NumAnalyzerLanes; ++lane) {
+        if ((activeLanes & (1u << lane)) == 0) {
+            lanePaths[lane].clear();
+            continue;
+        }
+        
+        while (pathGenerators[lane].getNumPathsAvailable()) {
+            pathGenerators[lane].getPath(lanePaths[lane]);
+        }
     }
 }
 
@@ -88,8 +105,7 @@ void ResponseCurveComponent::timerCallback()
     auto fftBounds = getAnalysisArea().toFloat();
     auto sampleRate = audioProcessor.getSampleRate();
     
-    leftPathProducer.process(fftBounds, sampleRate);
-    rightPathProducer.process(fftBounds, sampleRate);
+    pathProducer.process(fftBounds, sampleRate, audioProcessor.getActiveAnalyzerLanes());
     
     if (parametersChanged.compareAndSetBool(false, true)) {
         updateChain();
@@ -102,53 +118,22 @@ void ResponseCurveComponent::paint(juce::Graphics& g)
 {
     g.fillAll(juce::Colour(14u, 14u, 14u));
 
-    g.drawImage(background, getLocalBounds().toFloat());
+    if (background != nullptr)
+        g.drawImage(*background, getLocalBounds().toFloat());
     
     auto responseArea = getAnalysisArea();
     
     auto w = responseArea.getWidth();
     
-    auto& lowcut = monoChain.get<ChainPositions::LowCut>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
-    auto& highcut = monoChain.get<ChainPositions::HighCut>();
-    
+    //the analyzer runs at the host rate, the chain was designed at the processing rate
     auto sampleRate = audioProcessor.getSampleRate();
     
     std::vector<double> mags;
     mags.resize(w);
     
     for (int i = 0; i < w; ++i) {
-        double mag = 1.0f;
         auto freq = juce::mapToLog10(double (i) / double (w), 20.0, 20000.0);
-        
-        if (!monoChain.isBypassed<ChainPositions::Peak>())
-            mag *= peak.coefficients -> getMagnitudeForFrequency(freq, sampleRate);
-        
-        if (!monoChain.isBypassed<ChainPositions::LowCut>())
-        {
-            if (!lowcut.isBypassed<0>())
-                mag *= lowcut.get<0>().coefficients -> getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowcut.isBypassed<1>())
-                mag *= lowcut.get<1>().coefficients -> getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowcut.isBypassed<2>())
-                mag *= lowcut.get<2>().coefficients -> getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowcut.isBypassed<3>())
-                mag *= lowcut.get<3>().coefficients -> getMagnitudeForFrequency(freq, sampleRate);
-        }
-        
-        if (!monoChain.isBypassed<ChainPositions::HighCut>())
-        {
-            if (!highcut.isBypassed<0>())
-                mag *= highcut.get<0>().coefficients -> getMagnitudeForFrequency(freq, sampleRate);
-            if (!highcut.isBypassed<1>())
-                mag *= highcut.get<1>().coefficients -> getMagnitudeForFrequency(freq, sampleRate);
-            if (!highcut.isBypassed<2>())
-                mag *= highcut.get<2>().coefficients -> getMagnitudeForFrequency(freq, sampleRate);
-            if (!highcut.isBypassed<3>())
-                mag *= highcut.get<3>().coefficients -> getMagnitudeForFrequency(freq, sampleRate);
-        }
-        
-        mags[i] = juce::Decibels::gainToDecibels(mag);
+        mags[i] = juce::Decibels::gainToDecibels(getChainMagnitude(monoChain, freq, chainRate));
     }
     
     // map function
@@ -168,15 +153,45 @@ void ResponseCurveComponent::paint(juce::Graphics& g)
     
     // SPECTRUM ANALYZER
     
-    auto leftChannelFFTPath = leftPathProducer.getPath();
-    leftChannelFFTPath.applyTransform(juce::AffineTransform().translation(responseArea.getX(), responseArea.getY()-11));
-    g.setColour(juce::Colours::white);
-    g.strokePath(leftChannelFFTPath, juce::PathStrokeType(1.0f));
-
-    auto rightChannelFFTPath = rightPathProducer.getPath();
-    rightChannelFFTPath.applyTransform(juce::AffineTransform().translation(responseArea.getX(), responseArea.getY()-11));
-    g.setColour(juce::Colours::dimgrey);
-    g.strokePath(rightChannelFFTPath, juce::PathStrokeType(1.0f));
+    auto drawLane = [&](AnalyzerLane lane, juce::Colour colour)
+    {
+        auto path = pathProducer.getPath(lane);
+        path.applyTransform(juce::AffineTransform().translation(responseArea.getX(), responseArea.getY()-11));
+        g.setColour(colour);
+        g.strokePath(path, juce::PathStrokeType(1.0f));
+    };
+    
+    drawLane(AnalyzerLane::PreLeft, juce::Colours::steelblue);
+    drawLane(AnalyzerLane::PreRight, juce::Colours::steelblue.darker());
+    drawLane(AnalyzerLane::PostLeft, juce::Colours::white);
+    drawLane(AnalyzerLane::PostRight, juce::Colours::dimgrey);
+    drawLane(AnalyzerLane::Sidechain, juce::Colours::mediumpurple);
+    
+    // difference spectrum (output - input), drawn on the same dB scale as the response curve
+    const auto& difference = pathProducer.getDifferenceSpectrum();
+    if (!difference.empty()) {
+        const auto& normalizedFrequencies = pathProducer.getNormalizedFrequencies();
+        juce::Path differenceCurve;
+        bool started = false;
+        
+        for (size_t i = 0; i < difference.size(); ++i) {
+            auto freq = normalizedFrequencies[i] * sampleRate;
+            if (freq < 20.0 || freq > 20000.0)
+                continue;
+            
+            auto x = responseArea.getX() + w * juce::mapFromLog10(freq, 20.0, 20000.0);
+            auto y = map(juce::jlimit(-24.0, 24.0, (double) difference[i]));
+            
+            if (!started)
+                differenceCurve.startNewSubPath(x, y);
+            else
+                differenceCurve.lineTo(x, y);
+            started = true;
+        }
+        
+        g.setColour(juce::Colours::lightgreen);
+        g.strokePath(differenceCurve, juce::PathStrokeType(1.0f));
+    }
     
     // draw border ResponseCurveComponen
     g.setColour(juce::Colours::white);
@@ -194,9 +209,25 @@ void ResponseCurveComponent::paint(juce::Graphics& g)
 
 void ResponseCurveComponent::resized()
 {
-    background = juce::Image(juce::Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    //editors of the same size and scale draw the same grid, so they share one image
+    const auto scale = juce::Component::getApproximateScaleFactorForComponent(this);
+    const auto width = getWidth(), height = getHeight();
     
-    juce::Graphics g(background);
+    background = SharedCache<BackgroundKey, juce::Image>::getInstance().get(BackgroundKey(width, height, scale), [width, height, scale]
+    {
+        return std::make_shared<const juce::Image>(renderBackground(width, height, scale));
+    });
+}
+
+juce::Image ResponseCurveComponent::renderBackground(int width, int height, float scale)
+{
+    juce::Image image(juce::Image::PixelFormat::RGB,
+                      juce::jmax(1, juce::roundToInt(width * scale)),
+                      juce::jmax(1, juce::roundToInt(height * scale)),
+                      true);
+    
+    juce::Graphics g(image);
+    g.addTransform(juce::AffineTransform::scale(scale));
     
     // FREQUENCY LINES
     
@@ -208,18 +239,18 @@ void ResponseCurveComponent::resized()
         20000
     };
     
-    auto renderArea = getAnalysisArea();
+    auto renderArea = getAnalysisArea({ width, height });
     auto left = renderArea.getX();
     auto right = renderArea.getRight();
     auto top = renderArea.getY();
     auto bottom = renderArea.getBottom();
-    auto width = renderArea.getWidth();
+    auto areaWidth = renderArea.getWidth();
     
     juce::Array<float> xs;
     
     for (auto f : freqs) {
         auto normX = juce::mapFromLog10(f, 20.0f, 20000.0f);
-        xs.add(left + width * normX);
+        xs.add(left + areaWidth * normX);
     }
     
     g.setColour(juce::Colours::dimgrey);
@@ -297,11 +328,12 @@ void ResponseCurveComponent::resized()
         
         g.drawFittedText(str, r, juce::Justification::left, 1);
     }
+    
+    return image;
 }
 
-juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea()
+juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea(juce::Rectangle<int> bounds)
 {
-    auto bounds = getLocalBounds();
     bounds.removeFromTop(24);
     bounds.removeFromBottom(14);
     bounds.removeFromLeft(30);
@@ -311,20 +343,63 @@ juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea()
 
 void ResponseCurveComponent::updateChain()
 {
-    auto chainSettings = getChainSettings(audioProcessor.apvts);
+    chainRate = audioProcessor.getProcessingRate();
+    setChainResponse(monoChain, audioProcessor.getTargetSettings(), chainRate);
+}
+
+//====LEVEL=METER=COMPONENT=====================================================
+
+LevelMeterComponent::LevelMeterComponent(EQAudioProcessor& p) :
+audioProcessor(p)
+{
+    startTimerHz(30);
+}
+
+void LevelMeterComponent::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colour(14u, 14u, 14u));
+    
+    auto bounds = getLocalBounds();
     
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    paintMeter(g, bounds.removeFromTop(bounds.getHeight() / 2), "IN", MeterTap::Input);
+    paintMeter(g, bounds, "OUT", MeterTap::Output);
+}
+
+void LevelMeterComponent::paintMeter(juce::Graphics& g, juce::Rectangle<int> area, const juce::String& name, MeterTap tap)
+{
+    const auto options = audioProcessor.getMeterOptions();
+    const auto readings = audioProcessor.getMeterReadings(tap);
     
-    auto peakCoefficients = makePeakFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    g.setColour(juce::Colours::lightgrey);
+    g.setFont(12);
+    g.drawFittedText(name, area.removeFromLeft(30), juce::Justification::centredLeft, 1);
+    
+    // numeric readouts
+    juce::String text;
+    if (options.truePeak)
+        text << "TP " << juce::String(readings.truePeakDb, 1) << "  ";
+    if (options.loudness)
+        text << "M " << juce::String(readings.momentaryLufs, 1) << "  S " << juce::String(readings.shortTermLufs, 1) << " LUFS";
+    g.drawFittedText(text, area.removeFromRight(220), juce::Justification::centredRight, 1);
+    
+    // bar: RMS filled, peak as a marker, -60 ... 0 dB
+    auto bar = area.reduced(4, 5).toFloat();
+    g.setColour(juce::Colours::darkgrey);
+    g.drawRect(bar);
+    
+    if (!options.levels)
+        return;
+    
+    auto toX = [bar](float db)
+    {
+        return juce::jmap(juce::jlimit(-60.0f, 0.0f, db), -60.0f, 0.0f, bar.getX(), bar.getRight());
+    };
     
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
+    g.setColour(juce::Colours::saddlebrown);
+    g.fillRect(bar.withRight(toX(readings.rmsDb)));
     
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    g.setColour(juce::Colours::orange);
+    g.fillRect(juce::Rectangle<float>(toX(readings.peakDb) - 1.0f, bar.getY(), 2.0f, bar.getHeight()));
 }
 
 //==============================================================================
@@ -332,18 +407,15 @@ void ResponseCurveComponent::updateChain()
 EQAudioProcessorEditor::EQAudioProcessorEditor (EQAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p),
 
-peakFreqSliderAttachment(audioProcessor.apvts, "Peak Freq", peakFreqSlider),
-peakGainSliderAttachment(audioProcessor.apvts, "Peak Gain", peakGainSlider),
-peakQualitySliderAttachment(audioProcessor.apvts, "Peak Quality", peakQualitySlider),
-lowCutFreqSliderAttachment(audioProcessor.apvts, "LowCut Freq", lowCutFreqSlider),
-highCutFreqSliderAttachment(audioProcessor.apvts, "HighCut Freq", highCutFreqSlider),
-lowCutSlopeSliderAttachment(audioProcessor.apvts, "LowCut Slope", lowCutSlopeSlider),
-highCutSlopeSliderAttachment(audioProcessor.apvts, "HighCut Slope", highCutSlopeSlider),
+lowCutFreqSliderAttachment(audioProcessor.apvts, getParameterID(Param_LowCutFreq), lowCutFreqSlider),
+highCutFreqSliderAttachment(audioProcessor.apvts, getParameterID(Param_HighCutFreq), highCutFreqSlider),
+lowCutSlopeSliderAttachment(audioProcessor.apvts, getParameterID(Param_LowCutSlope), lowCutSlopeSlider),
+highCutSlopeSliderAttachment(audioProcessor.apvts, getParameterID(Param_HighCutSlope), highCutSlopeSlider),
 
-lowcutBypassButtonAttachment(audioProcessor.apvts, "LowCut Bypassed", lowCutBypassButton),
-peakBypassButtonAttachment(audioProcessor.apvts, "Peak Bypassed", peakBypassButton),
-highcutBypassButtonAttachment(audioProcessor.apvts, "HighCut Bypassed", highCutBypassButton), 
+lowcutBypassButtonAttachment(audioProcessor.apvts, getParameterID(Param_LowCutBypassed), lowCutBypassButton),
+highcutBypassButtonAttachment(audioProcessor.apvts, getParameterID(Param_HighCutBypassed), highCutBypassButton), 
 
+levelMeterComponent(audioProcessor),
 responseCurveComponent(audioProcessor)
 
 {
@@ -387,6 +459,16 @@ responseCurveComponent(audioProcessor)
     peakBypassLabel.setJustificationType(juce::Justification::centred);
     peakBypassLabel.attachToComponent(&peakBypassButton, true);
     
+    for (size_t band = 0; band < maxBands; ++band) {
+        bandBox.addItem("Band " + juce::String((int) band + 1), (int) band + 1);
+    }
+    if (auto* type = dynamic_cast<juce::AudioParameterChoice*>(audioProcessor.apvts.getParameter(getBandParameterID(0, BandParam_Type)))) {
+        bandTypeBox.addItemList(type->choices, 1);
+    }
+    bandBox.onChange = [this]() { selectBand((size_t) juce::jmax(0, bandBox.getSelectedItemIndex())); };
+    bandBox.setSelectedItemIndex(0, juce::dontSendNotification);
+    selectBand(0);
+    
     //LOW CUT FILTER
     
     lowCutFreqSlider.setLookAndFeel(&lnf);
@@ -439,6 +521,36 @@ responseCurveComponent(audioProcessor)
     highCutBypassLabel.setJustificationType(juce::Justification::centred);
     highCutBypassLabel.attachToComponent(&highCutBypassButton, true);
     
+    //ANALYZER
+    
+    preEqAnalyzerButton.setButtonText("Show input spectrum");
+    preEqAnalyzerButton.setToggleState(audioProcessor.isPreEqTapEnabled(), juce::dontSendNotification);
+    preEqAnalyzerButton.onClick = [this]()
+    {
+        audioProcessor.setPreEqTapEnabled(preEqAnalyzerButton.getToggleState());
+    };
+    
+    //METERS
+    
+    const auto meterOptions = audioProcessor.getMeterOptions();
+    meterLevelsButton.setButtonText("Meters");
+    meterLevelsButton.setToggleState(meterOptions.levels, juce::dontSendNotification);
+    meterTruePeakButton.setButtonText("True peak");
+    meterTruePeakButton.setToggleState(meterOptions.truePeak, juce::dontSendNotification);
+    meterLoudnessButton.setButtonText("LUFS");
+    meterLoudnessButton.setToggleState(meterOptions.loudness, juce::dontSendNotification);
+    
+    for (auto* button : { &meterLevelsButton, &meterTruePeakButton, &meterLoudnessButton }) {
+        button->onClick = [this]() { updateMeterOptions(); };
+    }
+    
+    //FILTER TOPOLOGY
+    
+    if (auto* topology = dynamic_cast<juce::AudioParameterChoice*>(audioProcessor.apvts.getParameter(getParameterID(Param_FilterTopology)))) {
+        topologyBox.addItemList(topology->choices, 1);
+    }
+    topologyBoxAttachment = std::make_unique<APTVS::ComboBoxAttachment>(audioProcessor.apvts, getParameterID(Param_FilterTopology), topologyBox);
+    
     setSize (940, 620);
     
     setResizable(false, false);
@@ -448,6 +560,34 @@ EQAudioProcessorEditor::~EQAudioProcessorEditor()
 {
 }
 
+void EQAudioProcessorEditor::selectBand(size_t band)
+{
+    auto& apvts = audioProcessor.apvts;
+    
+    //the old attachments have to go first, a control can only be attached to one parameter
+    peakFreqSliderAttachment.reset();
+    peakGainSliderAttachment.reset();
+    peakQualitySliderAttachment.reset();
+    peakBypassButtonAttachment.reset();
+    bandTypeBoxAttachment.reset();
+    
+    peakFreqSliderAttachment = std::make_unique<SliderAttachment>(apvts, getBandParameterID(band, BandParam_Freq), peakFreqSlider);
+    peakGainSliderAttachment = std::make_unique<SliderAttachment>(apvts, getBandParameterID(band, BandParam_Gain), peakGainSlider);
+    peakQualitySliderAttachment = std::make_unique<SliderAttachment>(apvts, getBandParameterID(band, BandParam_Quality), peakQualitySlider);
+    peakBypassButtonAttachment = std::make_unique<ButtonAttachment>(apvts, getBandParameterID(band, BandParam_Bypassed), peakBypassButton);
+    bandTypeBoxAttachment = std::make_unique<APTVS::ComboBoxAttachment>(apvts, getBandParameterID(band, BandParam_Type), bandTypeBox);
+}
+
+void EQAudioProcessorEditor::updateMeterOptions()
+{
+    MeterOptions options;
+    options.levels = meterLevelsButton.getToggleState();
+    options.truePeak = meterTruePeakButton.getToggleState();
+    options.loudness = meterLoudnessButton.getToggleState();
+    
+    audioProcessor.setMeterOptions(options);
+}
+
 //==============================================================================
 void EQAudioProcessorEditor::paint (juce::Graphics& g)
 {
@@ -464,7 +604,7 @@ void EQAudioProcessorEditor::paint (juce::Graphics& g)
     juce::Rectangle<int> peakText = peakQualitySlider.getBounds();
     peakText.setY(peakText.getY()+50);
     peakText.setX(peakText.getX()-65);
-    g.drawFittedText("PEAK", peakText, juce::Justification::centredBottom, 1);
+    g.drawFittedText("BANDS", peakText, juce::Justification::centredBottom, 1);
     
     juce::Rectangle<int> highcutText = highCutSlopeSlider.getBounds();
     highcutText.setY(highcutText.getY()+50);
@@ -500,11 +640,22 @@ void EQAudioProcessorEditor::resized()
     highCutSlopeSlider.setBounds(highCutArea.removeFromRight(200));
     
     auto peakBypassButtonPos = bounds.removeFromTop(25);
-    peakBypassButtonPos.setX(peakBypassButtonPos.getX() + 196 - 40);
+    bandBox.setBounds(peakBypassButtonPos.withWidth(80).reduced(2));
+    bandTypeBox.setBounds(peakBypassButtonPos.withX(peakBypassButtonPos.getX() + 80).withWidth(95).reduced(2));
+    peakBypassButtonPos.setX(peakBypassButtonPos.getX() + 196 + 30);
     peakBypassButton.setBounds(peakBypassButtonPos);
     peakFreqSlider.setBounds(bounds.removeFromTop(bounds.getHeight() * 0.33).removeFromRight(200));
     peakGainSlider.setBounds(bounds.removeFromTop(bounds.getHeight() * 0.5).removeFromRight(200));
     peakQualitySlider.setBounds(bounds.removeFromRight(200));
+    
+    auto analyzerOptionsArea = getLocalBounds().reduced(10).removeFromBottom(40);
+    preEqAnalyzerButton.setBounds(analyzerOptionsArea.removeFromLeft(180).withSizeKeepingCentre(180, 25));
+    
+    for (auto* button : { &meterLevelsButton, &meterTruePeakButton, &meterLoudnessButton }) {
+        button->setBounds(analyzerOptionsArea.removeFromLeft(90).withSizeKeepingCentre(90, 25));
+    }
+    topologyBox.setBounds(analyzerOptionsArea.removeFromRight(130).withSizeKeepingCentre(130, 25));
+    levelMeterComponent.setBounds(analyzerOptionsArea);
 }
 
 // returns an array with component's references
@@ -526,6 +677,17 @@ std::vector<juce::Component*> EQAudioProcessorEditor::getComps()
         &peakBypassButton,
         &highCutBypassButton,
         
+        &preEqAnalyzerButton,
+        
+        &meterLevelsButton,
+        &meterTruePeakButton,
+        &meterLoudnessButton,
+        &levelMeterComponent,
+        
+        &topologyBox,
+        &bandBox,
+        &bandTypeBox,
+        
         &peakFreqLabel,
         &peakGainLabel,
         &peakQualityLabel,
@@ -10,6 +10,11 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "FFTBackend.h"
+#include "SharedCache.h"
+
+#include <memory>
+#include <tuple>
 
 enum FFTOrder
 {
@@ -18,68 +23,306 @@ enum FFTOrder
     order8192 = 13
 };
 
+/*
+ Multi-resolution analyzer: the same small FFT is run on the full-band signal and on
+ octave-decimated copies of it. Band 0 covers the top of the spectrum at full rate, every
+ further band halves the sample rate (and therefore the bin width) for the octave below.
+ The per-band spectra are stitched into one list of (frequency, dB) points.
+
+ Several lanes (e.g. pre and post EQ) are analysed together: their spectra are computed
+ two at a time by packing one lane into the real and the other into the imaginary part
+ of a single complex transform.
+ */
 template<typename BlockType>
-struct FFTDataGenerator
+struct MultiResolutionFFTDataGenerator
 {
-    void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
+    static constexpr int NumBands = 4;
+
+    void prepare(FFTOrder newOrder, int lanes, FFTBackendType backendType = getDefaultFFTBackendType())
     {
+        order = newOrder;
+        numLanes = lanes;
         const auto fftSize = getFFTSize();
-        
-        fftData.assign(fftData.size(), 0);
-        auto* readIndex = audioData.getReadPointer(0);
-        std::copy(readIndex, readIndex + fftSize, fftData.begin());
-        
-        // first apply a windowing function to our data
-        window->multiplyWithWindowingTable (fftData.data(), fftSize);       // [1]
-        
-        // then render our FFT data..
-        forwardFFT->performFrequencyOnlyForwardTransform (fftData.data());  // [2]
-        
-        int numBins = (int)fftSize / 2;
-        
-        //normalize the fft values.
-        for( int i = 0; i < numBins; ++i )
+
+        forwardFFT = createFFTBackend(backendType, order);
+
+        windowTable = getSharedWindowTable(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
+
+        realInput.assign(fftSize, 0);
+        complexInput.assign(fftSize, {});
+        complexOutput.assign(fftSize, {});
+
+        //anti-alias filter for every 2:1 decimation, normalized to the rate of the band it reads from.
+        //everything that can alias below a quarter of the decimated rate is attenuated by more than 40 dB.
+        //the coefficients are only read, every lane of every analyzer shares them.
+        const int antiAliasOrder = 8;
+        antiAliasCoefficients = SharedCache<int, AntiAliasCoefficients>::getInstance().get(antiAliasOrder, [antiAliasOrder]
+        {
+            return std::make_shared<const AntiAliasCoefficients>(juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(0.2f, 1.0, antiAliasOrder));
+        });
+
+        for( int b = 0; b < NumBands; ++b )
         {
-            fftData[i] /= (float) numBins;
+            auto& band = bands[b];
+            band.writeIndex = 0;
+            band.newSamples = 0;
+            band.decimatePhase = 0;
+
+            band.lanes.resize(numLanes);
+            for( auto& lane : band.lanes )
+            {
+                lane.history.assign(fftSize, 0);
+                lane.spectrum.assign(fftSize / 2, -std::numeric_limits<float>::infinity());
+
+                lane.antiAlias.clear();
+                if( b > 0 )
+                    for( auto* coefficients : *antiAliasCoefficients )
+                        lane.antiAlias.emplace_back(coefficients);
+            }
         }
-        
-        //convert them to decibels
-        for( int i = 0; i < numBins; ++i )
+
+        //band 0 uses bins [N/8, N/2), inner bands [N/8, N/4), the lowest band [1, N/4).
+        //listed from the lowest frequency upwards so the result can be drawn left to right.
+        binRanges.clear();
+        normalizedFrequencies.clear();
+        for( int b = NumBands - 1; b >= 0; --b )
         {
-            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
+            const int first = (b == NumBands - 1) ? 1 : fftSize / 8;
+            const int last = (b == 0) ? fftSize / 2 : fftSize / 4;
+            binRanges.push_back({b, first, last});
+
+            for( int bin = first; bin < last; ++bin )
+                normalizedFrequencies.push_back((float) bin / (float) (fftSize << b));
         }
-        
-        fftDataFifo.push(fftData);
+
+        stitched.assign(normalizedFrequencies.size() * numLanes, 0);
+        fftDataFifo.prepare(stitched.size());
     }
-    
-    void changeOrder(FFTOrder newOrder)
+
+    /*
+     'frames' holds 'numFrames' interleaved frames of 'getNumLanes()' samples.
+     lanes whose bit is not set in 'activeLanes' are skipped and report an empty spectrum.
+     */
+    void pushFrames(const float* frames, int numFrames, juce::uint32 activeLanes, const float negativeInfinity)
     {
-        //when you change order, recreate the window, forwardFFT, fifo, fftData
-        //also reset the fifoIndex
-        //things that need recreating should be created on the heap via std::make_unique<>
-        
-        order = newOrder;
-        auto fftSize = getFFTSize();
-        
-        forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
-        
-        fftData.clear();
-        fftData.resize(fftSize * 2, 0);
-
-        fftDataFifo.prepare(fftData.size());
+        const int hopSize = getFFTSize() / 4;
+        bool anyBandUpdated = false;
+        int numInput = numFrames;
+
+        for( int b = 0; b < NumBands; ++b )
+        {
+            auto& band = bands[b];
+            const int writeIndex = band.writeIndex;
+            const int decimatePhase = band.decimatePhase;
+            int numBandSamples = numInput;
+
+            for( int l = 0; l < numLanes; ++l )
+            {
+                if( ! isActive(activeLanes, l) )
+                    continue;
+
+                auto& lane = band.lanes[l];
+
+                if( b == 0 )
+                {
+                    lane.input.resize((size_t) numFrames);
+                    for( int i = 0; i < numFrames; ++i )
+                        lane.input[i] = frames[i * numLanes + l];
+                }
+                else
+                {
+                    //decimate the previous band's input by 2
+                    const auto& previous = bands[b - 1].lanes[l].input;
+                    lane.input.resize((size_t) numInput / 2 + 1);
+                    int phase = decimatePhase;
+                    numBandSamples = 0;
+
+                    for( int i = 0; i < numInput; ++i )
+                    {
+                        auto y = previous[i];
+                        for( auto& f : lane.antiAlias )
+                            y = f.processSample(y);
+
+                        if( phase == 0 )
+                            lane.input[numBandSamples++] = y;
+                        phase ^= 1;
+                    }
+                }
+
+                int index = writeIndex;
+                for( int i = 0; i < numBandSamples; ++i )
+                {
+                    lane.history[index] = lane.input[i];
+                    if( ++index == (int) lane.history.size() )
+                        index = 0;
+                }
+            }
+
+            if( b > 0 )
+            {
+                numBandSamples = (numInput + 1 - decimatePhase) / 2;
+                band.decimatePhase = (decimatePhase + numInput) & 1;
+            }
+
+            band.writeIndex = (writeIndex + numBandSamples) % getFFTSize();
+            band.newSamples += numBandSamples;
+            numInput = numBandSamples;
+
+            if( band.newSamples >= hopSize )
+            {
+                band.newSamples %= hopSize;
+                produceSpectra(band, activeLanes, negativeInfinity);
+                anyBandUpdated = true;
+            }
+        }
+
+        if( anyBandUpdated )
+        {
+            size_t point = 0;
+            for( int l = 0; l < numLanes; ++l )
+                for( const auto& range : binRanges )
+                    for( int bin = range.firstBin; bin < range.lastBin; ++bin )
+                        stitched[point++] = bands[range.band].lanes[l].spectrum[bin];
+
+            fftDataFifo.push(stitched);
+        }
     }
     //==============================================================================
     int getFFTSize() const { return 1 << order; }
+    int getNumLanes() const { return numLanes; }
     int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
+    //normalized to the sample rate, one entry per point of a lane's stitched spectrum
+    const std::vector<float>& getNormalizedFrequencies() const { return normalizedFrequencies; }
     //==============================================================================
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    //every block holds the stitched spectrum of lane 0, then lane 1, ...
+    bool getFFTData(BlockType& data) { return fftDataFifo.pull(data); }
 private:
+    struct Lane
+    {
+        std::vector<float> history, input, spectrum;
+        std::vector<juce::dsp::IIR::Filter<float>> antiAlias;
+    };
+
+    struct Band
+    {
+        std::vector<Lane> lanes;
+        int writeIndex = 0, newSamples = 0, decimatePhase = 0;
+    };
+
+    struct BinRange
+    {
+        int band, firstBin, lastBin;
+    };
+
+    static bool isActive(juce::uint32 activeLanes, int lane) { return (activeLanes & (1u << lane)) != 0; }
+
+    using WindowTable = std::vector<float>;
+    using AntiAliasCoefficients = juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>>;
+
+    static std::shared_ptr<const WindowTable> getSharedWindowTable(int size, juce::dsp::WindowingFunction<float>::WindowingMethod method)
+    {
+        return SharedCache<std::pair<int, int>, WindowTable>::getInstance().get({ size, (int) method }, [size, method]
+        {
+            auto table = std::make_shared<WindowTable>((size_t) size, 0.f);
+            juce::dsp::WindowingFunction<float>::fillWindowingTables(table->data(), (size_t) size, method);
+            return table;
+        });
+    }
+
+    void produceSpectra(Band& band, juce::uint32 activeLanes, const float negativeInfinity)
+    {
+        const auto fftSize = getFFTSize();
+        const int numBins = fftSize / 2;
+
+        int pending = -1;
+
+        for( int l = 0; l < numLanes; ++l )
+        {
+            if( ! isActive(activeLanes, l) )
+            {
+                std::fill(band.lanes[l].spectrum.begin(), band.lanes[l].spectrum.end(), -std::numeric_limits<float>::infinity());
+                continue;
+            }
+
+            if( pending < 0 )
+            {
+                pending = l;
+                continue;
+            }
+
+            produceSpectraPair(band, &band.lanes[pending], &band.lanes[l], numBins, negativeInfinity);
+            pending = -1;
+        }
+
+        if( pending >= 0 )
+            produceSpectraPair(band, &band.lanes[pending], nullptr, numBins, negativeInfinity);
+    }
+
+    void produceSpectraPair(Band& band, Lane* first, Lane* second, int numBins, const float negativeInfinity)
+    {
+        const auto fftSize = getFFTSize();
+
+        if( second == nullptr )
+        {
+            produceSpectrum(band, *first, numBins, negativeInfinity);
+            return;
+        }
+
+        const auto& window = *windowTable;
+
+        //unroll the circular history, oldest sample first, and window it
+        for( int i = 0, index = band.writeIndex; i < fftSize; ++i )
+        {
+            complexInput[i] = { first->history[index] * window[i],
+                                second->history[index] * window[i] };
+
+            if( ++index == fftSize )
+                index = 0;
+        }
+
+        forwardFFT->performComplexForward(complexInput.data(), complexOutput.data());
+
+        //X[k] = (Z[k] + conj(Z[N-k])) / 2,  Y[k] = (Z[k] - conj(Z[N-k])) / 2j
+        for( int k = 0; k < numBins; ++k )
+        {
+            const auto z = complexOutput[k];
+            const auto zMirror = std::conj(complexOutput[(fftSize - k) % fftSize]);
+
+            first->spectrum[k] = juce::Decibels::gainToDecibels(std::abs(z + zMirror) * 0.5f / (float) numBins, negativeInfinity);
+            second->spectrum[k] = juce::Decibels::gainToDecibels(std::abs(z - zMirror) * 0.5f / (float) numBins, negativeInfinity);
+        }
+    }
+
+    //a lane without a partner goes through the (cheaper) real transform
+    void produceSpectrum(Band& band, Lane& lane, int numBins, const float negativeInfinity)
+    {
+        const auto fftSize = getFFTSize();
+        const auto& window = *windowTable;
+
+        for( int i = 0, index = band.writeIndex; i < fftSize; ++i )
+        {
+            realInput[i] = lane.history[index] * window[i];
+
+            if( ++index == fftSize )
+                index = 0;
+        }
+
+        forwardFFT->performRealForward(realInput.data(), complexOutput.data());
+
+        for( int k = 0; k < numBins; ++k )
+            lane.spectrum[k] = juce::Decibels::gainToDecibels(std::abs(complexOutput[k]) / (float) numBins, negativeInfinity);
+    }
+
     FFTOrder order;
-    BlockType fftData;
-    std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
-    
+    int numLanes = 1;
+    std::array<Band, NumBands> bands;
+    std::vector<BinRange> binRanges;
+    std::vector<float> normalizedFrequencies, stitched, realInput;
+    std::shared_ptr<const WindowTable> windowTable;
+    std::shared_ptr<const AntiAliasCoefficients> antiAliasCoefficients;
+    std::vector<FFTBackend::Complex> complexInput, complexOutput;
+    std::unique_ptr<FFTBackend> forwardFFT;
+
     Fifo<BlockType> fftDataFifo;
 };
 
@@ -87,20 +330,21 @@ template<typename PathType>
 struct AnalyzerPathGenerator
 {
     /*
-     converts 'renderData[]' into a juce::Path
+     converts a stitched multi-resolution spectrum into a juce::Path,
+     'normalizedFrequencies[i]' is the frequency of 'renderData[i]' divided by the sample rate
      */
     void generatePath(const std::vector<float>& renderData,
+                      const std::vector<float>& normalizedFrequencies,
                       juce::Rectangle<float> fftBounds,
-                      int fftSize,
-                      float binWidth,
+                      double sampleRate,
                       float negativeInfinity)
     {
+        jassert( renderData.size() == normalizedFrequencies.size() );
+
         auto top = fftBounds.getY();
         auto bottom = fftBounds.getHeight();
         auto width = fftBounds.getWidth();
 
-        int numBins = (int)fftSize / 2;
-
         PathType p;
         p.preallocateSpace(3 * (int)fftBounds.getWidth());
 
@@ -113,23 +357,20 @@ struct AnalyzerPathGenerator
 
         auto y = map(renderData[0]);
 
-        //jassert( !std::isnan(y) && !std::isinf(y) );
         if( std::isnan(y) || std::isinf(y) )
             y = bottom;
-        
+
         p.startNewSubPath(0, y);
 
-        const int pathResolution = 2; //you can draw line-to's every 'pathResolution' pixels.
+        const int pathResolution = 2; //you can draw line-to's every 'pathResolution' points.
 
-        for( int binNum = 1; binNum < numBins; binNum += pathResolution )
+        for( size_t i = 1; i < renderData.size(); i += pathResolution )
         {
-            y = map(renderData[binNum]);
-
-            //jassert( !std::isnan(y) && !std::isinf(y) );
+            y = map(renderData[i]);
 
             if( !std::isnan(y) && !std::isinf(y) )
             {
-                auto binFreq = binNum * binWidth;
+                auto binFreq = normalizedFrequencies[i] * (float) sampleRate;
                 auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
                 int binX = std::floor(normalizedBinX * width);
                 p.lineTo(binX, y);
@@ -166,24 +407,27 @@ public:
 
 struct PathProducer
 {
-    PathProducer(SingleChannelSampleFifo<EQAudioProcessor::BlockType>& scsf) :
-    leftChannelFifo(&scsf)
+    PathProducer(AnalyzerTapRing& ring) :
+    analyzerRing(&ring)
     {
-        leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-        monoBuffer.setSize(1, leftChannelFFTDataGenerator.getFFTSize());
+        fftDataGenerator.prepare(FFTOrder::order2048, NumAnalyzerLanes);
     }
-    void process(juce::Rectangle<float> fftBounds, double sampleRate);
-    juce::Path getPath() { return leftChannelFFTPath; }
+    void process(juce::Rectangle<float> fftBounds, double sampleRate, juce::uint32 activeLanes);
+    juce::Path getPath(AnalyzerLane lane) const { return lanePaths[lane]; }
+    
+    //output minus input in dB, averaged over both channels. Empty while the pre-EQ tap is off.
+    const std::vector<float>& getDifferenceSpectrum() const { return differenceSpectrum; }
+    const std::vector<float>& getNormalizedFrequencies() const { return fftDataGenerator.getNormalizedFrequencies(); }
     
 private:
-    SingleChannelSampleFifo<EQAudioProcessor::BlockType>* leftChannelFifo;
+    AnalyzerTapRing* analyzerRing;
     
-    juce::AudioBuffer<float> monoBuffer;
+    std::vector<float> incomingFrames, laneSpectrum, differenceSpectrum;
     
-    FFTDataGenerator<std::vector<float>> leftChannelFFTDataGenerator;
+    MultiResolutionFFTDataGenerator<std::vector<float>> fftDataGenerator;
     
-    AnalyzerPathGenerator<juce::Path> pathProducer;
-    juce::Path leftChannelFFTPath;
+    std::array<AnalyzerPathGenerator<juce::Path>, NumAnalyzerLanes> pathGenerators;
+    std::array<juce::Path, NumAnalyzerLanes> lanePaths;
 };
 
 //=======RESPONSE=CURVE=========================================================
@@ -212,14 +456,38 @@ private:
     juce::Atomic<bool> parametersChanged{false};
     
     MonoChain monoChain;
+    double chainRate = 44100.0;     //the processing rate monoChain was designed at
     
     void updateChain();
     
-    juce::Image background;
+    //width, height and display scale of a grid image
+    using BackgroundKey = std::tuple<int, int, float>;
+    std::shared_ptr<const juce::Image> background;
+    static juce::Image renderBackground(int width, int height, float scale);
     
-    juce::Rectangle<int> getAnalysisArea();
+    static juce::Rectangle<int> getAnalysisArea(juce::Rectangle<int> bounds);
+    juce::Rectangle<int> getAnalysisArea() { return getAnalysisArea(getLocalBounds()); }
     
-    PathProducer leftPathProducer, rightPathProducer;
+    PathProducer pathProducer;
+};
+
+//=======LEVEL=METERS===========================================================
+
+struct LevelMeterComponent : juce::Component,
+juce::Timer
+{
+    LevelMeterComponent(EQAudioProcessor&);
+    
+    //Timer
+    void timerCallback() override { repaint(); }
+    
+    //Component
+    void paint(juce::Graphics& g) override;
+    
+private:
+    EQAudioProcessor& audioProcessor;
+    
+    void paintMeter(juce::Graphics& g, juce::Rectangle<int> area, const juce::String& name, MeterTap tap);
 };
 
 //==============================================================================
@@ -262,12 +530,29 @@ private:
     
     using APTVS = juce::AudioProcessorValueTreeState;
     using SliderAttachment = APTVS::SliderAttachment;
-    SliderAttachment peakFreqSliderAttachment, peakGainSliderAttachment, peakQualitySliderAttachment, lowCutFreqSliderAttachment, highCutFreqSliderAttachment, lowCutSlopeSliderAttachment, highCutSlopeSliderAttachment;
+    SliderAttachment lowCutFreqSliderAttachment, highCutFreqSliderAttachment, lowCutSlopeSliderAttachment, highCutSlopeSliderAttachment;
     
     juce::ToggleButton lowCutBypassButton, peakBypassButton, highCutBypassButton;
     
     using ButtonAttachment = APTVS::ButtonAttachment;
-    ButtonAttachment lowcutBypassButtonAttachment, peakBypassButtonAttachment, highcutBypassButtonAttachment;
+    ButtonAttachment lowcutBypassButtonAttachment, highcutBypassButtonAttachment;
+    
+    //the middle column edits one band at a time, its attachments follow bandBox
+    juce::ComboBox bandBox, bandTypeBox;
+    std::unique_ptr<SliderAttachment> peakFreqSliderAttachment, peakGainSliderAttachment, peakQualitySliderAttachment;
+    std::unique_ptr<ButtonAttachment> peakBypassButtonAttachment;
+    std::unique_ptr<APTVS::ComboBoxAttachment> bandTypeBoxAttachment;
+    void selectBand(size_t band);
+    
+    juce::ToggleButton preEqAnalyzerButton;
+    
+    juce::ToggleButton meterLevelsButton, meterTruePeakButton, meterLoudnessButton;
+    void updateMeterOptions();
+    
+    juce::ComboBox topologyBox;
+    std::unique_ptr<APTVS::ComboBoxAttachment> topologyBoxAttachment;
+    
+    LevelMeterComponent levelMeterComponent;
     
     ResponseCurveComponent responseCurveComponent;
 
@@ -16,16 +16,28 @@ EQAudioProcessor::EQAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
                        )
 #endif
 {
+    //max quality half-bands, the cut filters go right up to the host's Nyquist
+    for (int order = Oversampling_2x; order <= Oversampling_4x; ++order)
+        oversamplers[(size_t) order - 1] = std::make_unique<juce::dsp::Oversampling<float>>(2, (size_t) order,
+                                                                                            juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR,
+                                                                                            true);
+    
+    for (int quality = LinearPhaseLow; quality <= LinearPhaseHigh; ++quality) {
+        const auto preset = getLinearPhasePreset(static_cast<LinearPhaseQuality>(quality));
+        linearPhaseConvolutions[(size_t) quality - 1] = std::make_unique<juce::dsp::Convolution>(juce::dsp::Convolution::Latency { preset.partitionSize });
+    }
 }
 
 EQAudioProcessor::~EQAudioProcessor()
 {
+    linearPhaseDesigner.stopThread(2000);
 }
 
 //==============================================================================
@@ -96,24 +108,71 @@ void EQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
     
-    juce::dsp::ProcessSpec spec;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 1;
-    spec.sampleRate = sampleRate;
+    linearPhaseDesigner.stopThread(2000);
+    oversamplingReset.cancelPendingUpdate();
+    
+    //a new timeline for the automation; an oversampling change keeps it
+    parameterChanges.clear();
+    hostPositionOffset = 0;
+    
+    preEqTapBuffer.setSize(2, samplesPerBlock);
+    
+    crossoverSettings = getCrossoverSettings(parameterHandles);
+    designCrossover(crossover, crossoverSettings, sampleRate);
+    crossover.prepare(samplesPerBlock);
+    
+    for (auto& meter : meters)
+        meter.prepare(sampleRate, samplesPerBlock, getMainBusNumOutputChannels());
     
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    //room for about half a second of audio between two editor refreshes
+    analyzerRing.prepare(juce::jmax(samplesPerBlock * 4, (int) sampleRate / 2));
     
-    updateFilters();
+    //the FIRs are designed again for the new rate before any of them is used
+    juce::dsp::ProcessSpec stereoSpec { sampleRate, (juce::uint32) samplesPerBlock, 2 };
+    for (auto& convolution : linearPhaseConvolutions)
+        convolution->prepare(stereoSpec);
+    for (auto& ready : linearPhaseReady)
+        ready.set(false);
     
-    leftChannelFifo.prepare(samplesPerBlock);
-    rightChannelFifo.prepare(samplesPerBlock);
+    linearPhaseWarmupBuffer.setSize(2, samplesPerBlock);
+    warmingLinearPhase = LinearPhaseOff;
+    runningLinearPhase = LinearPhaseOff;
+    linearPhaseDesigned = LinearPhaseOff;
+    
+    //after the convolutions, whose latency is part of the linear-phase one
+    prepareOversampling(sampleRate, samplesPerBlock);
+    
+    linearPhaseDesigner.startThread();
+}
+
+void EQAudioProcessor::prepareOversampling(double sampleRate, int samplesPerBlock)
+{
+    latencyUpdate.cancelPendingUpdate();
+    
+    //everything that runs inside the oversampling runs at processingRate, in blocks that much longer
+    preparedOversampling = static_cast<OversamplingFactor>((int) parameterHandles.get(Param_Oversampling));
+    oversamplingFactor = 1 << preparedOversampling;
+    processingRate = sampleRate * oversamplingFactor;
+    const auto processingBlockSize = samplesPerBlock * oversamplingFactor;
+    
+    for (auto& oversampler : oversamplers)
+        oversampler->initProcessing((size_t) samplesPerBlock);
+    
+    engine.setGridListener(&engineSettings);
+    engine.setSettings(getTargetSettings());
+    engine.prepare(processingRate, processingBlockSize, getMainBusNumOutputChannels());
+    
+    const auto quality = static_cast<LinearPhaseQuality>((int) parameterHandles.get(Param_LinearPhase));
+    latencyUpdate.latency = getReportedLatency(quality);
+    setLatencySamples(latencyUpdate.latency.get());
 }
 
 void EQAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    
+    linearPhaseDesigner.stopThread(2000);
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -135,6 +194,16 @@ bool EQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+    
+    // The sidechain only feeds the analyzer: disabled, mono or stereo are all fine.
+    if (layouts.inputBuses.size() > 1)
+    {
+        const auto& sidechain = layouts.getChannelSet(true, 1);
+        if (!sidechain.isDisabled()
+         && sidechain != juce::AudioChannelSet::mono()
+         && sidechain != juce::AudioChannelSet::stereo())
+            return false;
+    }
    #endif
 
     return true;
@@ -157,21 +226,328 @@ void EQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::Mid
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    updateFilters();
+    // the sidechain bus is only ever read by the analyzer, straight out of the host's buffer
+    auto sidechainBuffer = getBusBuffer(buffer, true, 1);
+    
+    auto mainBuffer = getBusBuffer(buffer, false, 0);
+    const auto meterOptions = getMeterOptions();
+    meters[MeterTap::Input].process(mainBuffer, meterOptions);
+    
+    //everything from here on sees the main bus only: with a mono main bus, channel 1 of
+    //the host's buffer is the sidechain
+    const auto numSamples = mainBuffer.getNumSamples();
+    const auto stereo = mainBuffer.getNumChannels() > 1;
+    const bool capturePreEq = isPreEqTapEnabled() && numSamples <= preEqTapBuffer.getNumSamples();
+    
+    if (capturePreEq) {
+        preEqTapBuffer.copyFrom(0, 0, mainBuffer, 0, 0, numSamples);
+        if (stereo)
+            preEqTapBuffer.copyFrom(1, 0, mainBuffer, 1, 0, numSamples);
+    }
+    
+    juce::dsp::AudioBlock<float> block (mainBuffer);
+    if (! processLinearPhase(block))
+        processOversampled(block, sidechainBuffer);
+    
+    processCrossover(block);
+    
+    meters[MeterTap::Output].process(mainBuffer, meterOptions);
+    
+    //a mono bus is drawn the same on both sides
+    AnalyzerTapRing::LanePointers lanes {};
+    lanes[AnalyzerLane::PostLeft] = mainBuffer.getReadPointer(0);
+    lanes[AnalyzerLane::PostRight] = mainBuffer.getReadPointer(stereo ? 1 : 0);
+    
+    if (capturePreEq) {
+        lanes[AnalyzerLane::PreLeft] = preEqTapBuffer.getReadPointer(0);
+        lanes[AnalyzerLane::PreRight] = preEqTapBuffer.getReadPointer(stereo ? 1 : 0);
+    }
+    
+    if (sidechainBuffer.getNumChannels() > 0)
+        lanes[AnalyzerLane::Sidechain] = sidechainBuffer.getReadPointer(0);
+    
+    analyzerRing.push(lanes, numSamples);
+}
+
+int EQAudioProcessor::getLinearPhaseLatency(LinearPhaseQuality quality)
+{
+    const auto preset = getLinearPhasePreset(quality);
+    return (1 << preset.firOrder) / 2 - 1 + getConvolution(quality).getLatency();
+}
+
+void EQAudioProcessor::processCrossover(juce::dsp::AudioBlock<float>& block)
+{
+    const auto settings = getCrossoverSettings(parameterHandles);
+    
+    if (! (settings == crossoverSettings)) {
+        designCrossover(crossover, settings, getSampleRate());
+        crossoverSettings = settings;
+    }
+    
+    if (settings.numBands < 2)
+        return;
+    
+    crossover.process(block);
+}
+
+int EQAudioProcessor::getOversamplingLatency() const
+{
+    if (preparedOversampling == Oversampling_Off)
+        return 0;
+    
+    return juce::roundToInt(oversamplers[(size_t) preparedOversampling - 1]->getLatencyInSamples());
+}
+
+//linear-phase mode runs at the host rate, so only one of the two latencies applies
+int EQAudioProcessor::getReportedLatency(LinearPhaseQuality quality)
+{
+    return quality == LinearPhaseOff ? getOversamplingLatency() : getLinearPhaseLatency(quality);
+}
+
+void EQAudioProcessor::OversamplingReset::handleAsyncUpdate()
+{
+    if (processor.getSampleRate() <= 0.0)
+        return;
+    
+    processor.suspendProcessing(true);
+    
+    //the designer reads the oversampling factor for the latency it reports
+    processor.linearPhaseDesigner.stopThread(2000);
+    
+    //the engine starts again from 0, the queued automation keeps its host positions.
+    //Nothing at the host rate is touched: the analyzer ring, meters, crossover and
+    //convolutions carry on as they were.
+    processor.hostPositionOffset = processor.getHostPosition(processor.engine.getPosition());
+    processor.prepareOversampling(processor.getSampleRate(), processor.getBlockSize());
+    
+    processor.linearPhaseDesigner.startThread();
+    processor.suspendProcessing(false);
+}
+
+void EQAudioProcessor::processOversampled(juce::dsp::AudioBlock<float>& block, const juce::AudioBuffer<float>& sidechain)
+{
+    //until the new factor is prepared, the old one keeps running
+    if ((int) parameterHandles.get(Param_Oversampling) != preparedOversampling)
+        oversamplingReset.triggerAsyncUpdate();
+    
+    if (preparedOversampling == Oversampling_Off) {
+        engine.process(block, sidechain);
+        return;
+    }
+    
+    auto stereoBlock = block.getSubsetChannelBlock(0, juce::jmin((size_t) 2, block.getNumChannels()));
+    auto& oversampler = *oversamplers[(size_t) preparedOversampling - 1];
+    
+    auto oversampledBlock = oversampler.processSamplesUp(stereoBlock);
+    engine.process(oversampledBlock, sidechain, preparedOversampling);
+    oversampler.processSamplesDown(stereoBlock);
+}
+
+void EQAudioProcessor::LatencyUpdate::handleAsyncUpdate()
+{
+    processor.setLatencySamples(latency.get());
+}
+
+void EQAudioProcessor::LinearPhaseDesigner::run()
+{
+    //parameter changes are picked up at most every 50 ms, the convolution crossfades each new FIR in
+    while (! threadShouldExit()) {
+        processor.designLinearPhase();
+        wait(50);
+    }
+}
+
+void EQAudioProcessor::designLinearPhase()
+{
+    const auto quality = static_cast<LinearPhaseQuality>((int) parameterHandles.get(Param_LinearPhase));
+    const auto latency = getReportedLatency(quality);
+    
+    //setLatencySamples tells the host straight away, which it only expects on the message thread
+    if (latencyUpdate.latency.exchange(latency) != latency)
+        latencyUpdate.triggerAsyncUpdate();
+    
+    if (quality == LinearPhaseOff)
+        return;
+    
+    //dynamic bands sit at their static gain here, the FIR cannot follow a detector
+    const auto chainSettings = getTargetSettings();
+    
+    if (quality == linearPhaseDesigned && chainSettings == linearPhaseSettings)
+        return;
+    
+    const auto firOrder = getLinearPhasePreset(quality).firOrder;
+    const auto linked = chainSettings.channelMode == ChannelMode::StereoLinked;
+    juce::AudioBuffer<float> fir;
+    
+    //unlinked, each path gets its own FIR: one channel of a stereo impulse response
+    for (int channel = 0; channel < (linked ? 1 : 2); ++channel) {
+        MonoChain chain;
+        setChainResponse(chain, chainSettings, getSampleRate(), linked ? -1 : channel);
+        auto pathFir = designLinearPhaseFir(chain, firOrder, getSampleRate());
+        
+        fir.setSize(linked ? 1 : 2, pathFir.getNumSamples(), true);
+        fir.copyFrom(channel, 0, pathFir, 0, 0, pathFir.getNumSamples());
+    }
+    
+    linearPhaseFirSize[(size_t) quality - 1].set(fir.getNumSamples());
+    getConvolution(quality).loadImpulseResponse(std::move(fir),
+                                                getSampleRate(),
+                                                linked ? juce::dsp::Convolution::Stereo::no : juce::dsp::Convolution::Stereo::yes,
+                                                juce::dsp::Convolution::Trim::no,
+                                                juce::dsp::Convolution::Normalise::no);
+    
+    linearPhaseMidSide[(size_t) quality - 1].set(chainSettings.channelMode == ChannelMode::MidSide);
+    linearPhaseReady[(size_t) quality - 1].set(true);
+    linearPhaseDesigned = quality;
+    linearPhaseSettings = chainSettings;
+}
+
+bool EQAudioProcessor::processLinearPhase(juce::dsp::AudioBlock<float>& block)
+{
+    const auto quality = static_cast<LinearPhaseQuality>((int) parameterHandles.get(Param_LinearPhase));
+    
+    const auto numSamples = (int) block.getNumSamples();
+    auto stereoBlock = block.getSubsetChannelBlock(0, juce::jmin((size_t) 2, block.getNumChannels()));
     
-    juce::dsp::AudioBlock<float> block (buffer);
+    const auto switchingIn = quality != LinearPhaseOff && runningLinearPhase != quality;
     
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    if (quality == LinearPhaseOff || ! linearPhaseReady[(size_t) quality - 1].get()
+        || (switchingIn && ! warmUpLinearPhase(quality, stereoBlock))) {
+        //back to the IIR chains: they start from silence and jump to the current settings
+        if (runningLinearPhase != LinearPhaseOff) {
+            engine.reset();
+            runningLinearPhase = LinearPhaseOff;
+        }
+        
+        return false;
+    }
+    
+    runningLinearPhase = quality;
+    
+    const auto midSide = linearPhaseMidSide[(size_t) quality - 1].get() && stereoBlock.getNumChannels() == 2;
+    
+    if (midSide)
+        encodeMidSide(stereoBlock, stereoBlock);
+    
+    getConvolution(quality).process(juce::dsp::ProcessContextReplacing<float>(stereoBlock));
+    
+    if (midSide)
+        decodeMidSide(stereoBlock);
+    
+    //automation still lands, on block boundaries
+    applyParameterChanges(getHostPosition(engine.getPosition()) + numSamples - 1);
+    engine.advance(numSamples * oversamplingFactor);
+    
+    return true;
+}
+
+//True once the convolution has been running the designed FIR for as long as its own
+//crossfade into it takes: before that its output would still be, or still fade in from,
+//whatever it ran before. Until then it runs on a copy of 'block' - the convolution only
+//installs a loaded FIR while it processes, so it has to run to get there.
+bool EQAudioProcessor::warmUpLinearPhase(LinearPhaseQuality quality, const juce::dsp::AudioBlock<float>& block)
+{
+    auto& convolution = getConvolution(quality);
+    
+    if (warmingLinearPhase != quality) {
+        convolution.reset();
+        warmingLinearPhase = quality;
+        linearPhaseWarmupSamples = 0;
+    }
+    
+    //this block goes through the convolution for real; a later switch back in warms up again
+    if (linearPhaseWarmupSamples >= juce::roundToInt(convolutionFadeSeconds * getSampleRate())) {
+        warmingLinearPhase = LinearPhaseOff;
+        return true;
+    }
+    
+    const auto midSide = linearPhaseMidSide[(size_t) quality - 1].get() && block.getNumChannels() == 2;
+    const auto maxChunk = (size_t) linearPhaseWarmupBuffer.getNumSamples();
+    
+    for (size_t start = 0; start < block.getNumSamples(); start += maxChunk) {
+        const auto length = juce::jmin(maxChunk, block.getNumSamples() - start);
+        const auto input = block.getSubBlock(start, length);
+        auto copy = juce::dsp::AudioBlock<float>(linearPhaseWarmupBuffer).getSubsetChannelBlock(0, block.getNumChannels())
+                                                                         .getSubBlock(0, length);
+        
+        if (midSide)
+            encodeMidSide(input, copy);
+        else
+            copy.copyFrom(input);
+        
+        convolution.process(juce::dsp::ProcessContextReplacing<float>(copy));
+    }
+    
+    if (convolution.getCurrentIRSize() == linearPhaseFirSize[(size_t) quality - 1].get())
+        linearPhaseWarmupSamples += (int) block.getNumSamples();
     
-    juce::dsp::ProcessContextReplacing<float> leftContext (leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext (rightBlock);
+    return false;
+}
+
+void EQAudioProcessor::applyParameterChanges(juce::int64 position)
+{
+    auto& parameters = getParameters();
     
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    while (auto* change = parameterChanges.peek()) {
+        if (change->samplePosition > position)
+            break;
+        
+        //the same calls a plugin wrapper makes for host automation
+        if (auto* parameter = parameters[change->parameterIndex]) {
+            parameter->setValue(change->normalisedValue);
+            parameter->sendValueChangedMessageToListeners(change->normalisedValue);
+        }
+        
+        parameterChanges.pop();
+    }
+}
+
+void EQAudioProcessor::EngineSettings::gridPointReached(juce::int64 position)
+{
+    processor.applyParameterChanges(processor.getHostPosition(position));
+    processor.engine.setSettings(processor.getTargetSettings());
+}
+
+juce::int64 EQAudioProcessor::EngineSettings::getNextChangePosition() const
+{
+    if (auto* change = processor.parameterChanges.peek())
+        return juce::jmax((juce::int64) 0, (change->samplePosition - processor.hostPositionOffset) * processor.oversamplingFactor);
     
-    leftChannelFifo.update(buffer);
-    rightChannelFifo.update(buffer);
+    return -1;
+}
+
+juce::uint32 EQAudioProcessor::getActiveAnalyzerLanes() const
+{
+    juce::uint32 lanes = (1u << AnalyzerLane::PostLeft) | (1u << AnalyzerLane::PostRight);
+    
+    if (isPreEqTapEnabled())
+        lanes |= (1u << AnalyzerLane::PreLeft) | (1u << AnalyzerLane::PreRight);
+    
+    if (isSidechainConnected())
+        lanes |= (1u << AnalyzerLane::Sidechain);
+    
+    return lanes;
+}
+
+void EQAudioProcessor::setMeterOptions(const MeterOptions& options)
+{
+    meterLevels.set(options.levels);
+    meterTruePeak.set(options.truePeak);
+    meterLoudness.set(options.loudness);
+}
+
+MeterOptions EQAudioProcessor::getMeterOptions() const
+{
+    MeterOptions options;
+    options.levels = meterLevels.get();
+    options.truePeak = meterTruePeak.get();
+    options.loudness = meterLoudness.get();
+    return options;
+}
+
+bool EQAudioProcessor::isSidechainConnected() const
+{
+    return getBusCount(true) > 1 && getChannelCountOfBus(true, 1) > 0;
 }
 
 //==============================================================================
@@ -192,8 +568,36 @@ void EQAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
     
+    //'DEQB', the format version, then the plain value of every parameter in getParameters()
+    //order; parameters are only ever appended, so older blobs stay valid. The filled
+    //snapshot slots follow, so a session's morph plays what it was saved with.
+    auto& parameters = getParameters();
+    
     juce::MemoryOutputStream mos(destData, true);
-    apvts.state.writeToStream(mos);
+    mos.writeInt(binaryStateMagic);
+    mos.writeInt(binaryStateVersion);
+    mos.writeInt(parameters.size());
+    
+    //the state tree's parameters are all ranged ones
+    for (auto* parameter : parameters)
+        mos.writeFloat(static_cast<juce::RangedAudioParameter*>(parameter)->convertFrom0to1(parameter->getValue()));
+    
+    std::vector<std::pair<size_t, ChainSettings>> filled;
+    ChainSettings snapshot;
+    for (size_t slot = 0; slot < numSnapshotSlots; ++slot)
+        if (snapshots.read(slot, snapshot))
+            filled.emplace_back(slot, snapshot);
+    
+    mos.writeInt((int) filled.size());
+    
+    for (const auto& entry : filled) {
+        juce::MemoryOutputStream record;
+        writeChainSettings(record, entry.second);
+        
+        mos.writeInt((int) entry.first);
+        mos.writeInt((int) record.getDataSize());
+        mos.write(record.getData(), record.getDataSize());
+    }
 }
 
 void EQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
@@ -201,119 +605,178 @@ void EQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
     
+    //No coefficients are designed here: the audio thread picks the new values up on its next
+    //grid point, and an instance that has not played yet designs them in prepareToPlay.
+    if (restoreBinaryState(data, sizeInBytes)) {
+        engine.snapToSettings();
+        return;
+    }
+    
+    //sessions saved before the binary format hold the whole ValueTree, and no snapshots
     auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
     if (tree.isValid()) {
+        for (size_t slot = 0; slot < numSnapshotSlots; ++slot)
+            snapshots.clear(slot);
+        
         apvts.replaceState(tree);
-        updateFilters();
+        engine.snapToSettings();
     }
 }
 
-juce::AudioProcessorValueTreeState::ParameterLayout EQAudioProcessor::createParameterLayout()
+bool EQAudioProcessor::restoreBinaryState(const void* data, int sizeInBytes)
 {
-    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    constexpr int headerSize = 3 * sizeof(int);
     
-    juce::NormalisableRange<float> rangeLowCutFreq (20.0f, 20000.0f, 1.0f, 0.25f);
-    layout.add(std::make_unique<juce::AudioParameterFloat>("LowCut Freq", "LowCut Freq", rangeLowCutFreq, 20.0f));
+    if (data == nullptr || sizeInBytes < headerSize)
+        return false;
     
-    juce::NormalisableRange<float> rangeHighCutFreq (20.0f, 20000.0f, 1.0f, 0.25f);
-    layout.add(std::make_unique<juce::AudioParameterFloat>("HighCut Freq", "HighCut Freq", rangeHighCutFreq, 20000.0f));
+    juce::MemoryInputStream mis(data, (size_t) sizeInBytes, false);
     
-    juce::NormalisableRange<float> rangePeakFreq (20.0f, 20000.0f, 1.0f, 0.25f);
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Freq", "Peak Freq", rangePeakFreq, 750.0f));
+    if (mis.readInt() != binaryStateMagic)
+        return false;
     
-    juce::NormalisableRange<float> rangePeakGain (-24.0f, +24.0f, 0.5f, 1.0f);
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Gain", "Peak Gain", rangePeakGain, 0.0f));
+    const auto version = mis.readInt();
+    if (! isKnownBinaryStateVersion(version))
+        return false;
     
-    juce::NormalisableRange<float> rangePeakQuality (0.1f, 10.0f, 0.05f, 1.0f);
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Quality", "Peak Quality", rangePeakQuality, 1.0f));
+    auto& parameters = getParameters();
+    const auto numStored = juce::jlimit(0, (sizeInBytes - headerSize) / (int) sizeof(float), mis.readInt());
     
-    juce::StringArray slopeOptions {"12 db/Oct", "24 db/Oct", "36 db/Oct", "48 db/Oct"};
-    layout.add(std::make_unique<juce::AudioParameterChoice>("LowCut Slope", "LowCut Slope", slopeOptions, 0));
-    layout.add(std::make_unique<juce::AudioParameterChoice>("HighCut Slope", "HighCut Slope", slopeOptions, 0));
+    //parameters the blob predates go back to their defaults, like replaceState does.
+    //A value outside its range rejects the blob.
+    const auto plain = storesPlainValues(version);
+    std::vector<float> values;
     
-    layout.add(std::make_unique<juce::AudioParameterBool>("LowCut Bypassed", "LowCut Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>("Peak Bypassed", "Peak Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>("HighCut Bypassed", "HighCut Bypassed", false));
+    for (int i = 0; i < parameters.size(); ++i) {
+        if (i >= numStored) {
+            values.push_back(parameters[i]->getDefaultValue());
+            continue;
+        }
+        
+        const auto stored = mis.readFloat();
+        auto* parameter = static_cast<juce::RangedAudioParameter*>(parameters[i]);
+        const auto& range = parameter->getNormalisableRange();
+        
+        if (plain ? ! (stored >= range.start && stored <= range.end) : ! (stored >= 0.0f && stored <= 1.0f))
+            return false;
+        
+        values.push_back(plain ? parameter->convertTo0to1(stored) : stored);
+    }
     
-    return layout;
-}
-
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& aptvs)
-{
-    ChainSettings settings;
+    //past the values of parameters this build no longer has
+    mis.setPosition(headerSize + (juce::int64) numStored * (juce::int64) sizeof(float));
+    
+    //version 1 has no snapshots, and a slot the blob does not fill is empty after loading it.
+    //A broken record rejects the whole blob: nothing is loaded rather than half of it.
+    std::array<ChainSettings, numSnapshotSlots> restored;
+    std::array<bool, numSnapshotSlots> filled {};
+    if (version >= 2 && ! readSnapshotRecords(mis, restored, filled))
+        return false;
     
-    settings.lowCutFreq = aptvs.getRawParameterValue("LowCut Freq")->load();
-    settings.highCutFreq = aptvs.getRawParameterValue("HighCut Freq")->load();
-    settings.peakFreq = aptvs.getRawParameterValue("Peak Freq")->load();
-    settings.peakGainDb = aptvs.getRawParameterValue("Peak Gain")->load();
-    settings.peakQuality = aptvs.getRawParameterValue("Peak Quality")->load();
-    settings.lowCutSlope = static_cast<Slope>(aptvs.getRawParameterValue("LowCut Slope")->load());
-    settings.highCutSlope = static_cast<Slope>(aptvs.getRawParameterValue("HighCut Slope")->load());
+    //the slots first, so a morph never runs between the new parameters and the old slots
+    for (size_t slot = 0; slot < numSnapshotSlots; ++slot) {
+        if (filled[slot])
+            snapshots.store(slot, restored[slot]);
+        else
+            snapshots.clear(slot);
+    }
     
-    settings.lowCutBypassed = aptvs.getRawParameterValue("LowCut Bypassed")->load() > 0.5f;
-    settings.peakBypassed = aptvs.getRawParameterValue("Peak Bypassed")->load() > 0.5f;
-    settings.highCutBypassed = aptvs.getRawParameterValue("HighCut Bypassed")->load() > 0.5f;
+    //the same calls a plugin wrapper makes for host automation
+    for (int i = 0; i < parameters.size(); ++i) {
+        parameters[i]->setValue(values[(size_t) i]);
+        parameters[i]->sendValueChangedMessageToListeners(values[(size_t) i]);
+    }
     
-    return settings;
+    return true;
 }
 
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate)
+juce::AudioProcessorValueTreeState::ParameterLayout EQAudioProcessor::createParameterLayout()
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
-                                                               chainSettings.peakFreq,
-                                                               chainSettings.peakQuality,
-                                                               juce::Decibels::decibelsToGain(chainSettings.peakGainDb));;
+    //see Parameters.h
+    return createParameterLayoutFromTable();
 }
 
-void updateCoefficients(Coefficients &old, const Coefficients &replacements)
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& aptvs)
 {
-    *old = *replacements;
+    return getChainSettings(ParameterHandles(aptvs));
 }
 
-void EQAudioProcessor::updatePeakFilter(const ChainSettings &chainSettings)
+void setChainParameters(juce::AudioProcessorValueTreeState& apvts, const ChainSettings& settings)
 {
-    auto peakCoefficients = makePeakFilter(chainSettings, getSampleRate());
+    auto set = [&apvts](const juce::String& id, float value)
+    {
+        if (auto* parameter = apvts.getParameter(id)) {
+            parameter->beginChangeGesture();
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+            parameter->endChangeGesture();
+        }
+    };
+    
+    set(getParameterID(Param_LowCutFreq), settings.lowCutFreq);
+    set(getParameterID(Param_HighCutFreq), settings.highCutFreq);
+    set(getParameterID(Param_LowCutSlope), (float) settings.lowCutSlope);
+    set(getParameterID(Param_HighCutSlope), (float) settings.highCutSlope);
+    
+    set(getParameterID(Param_LowCutType), (float) settings.lowCutShape.family);
+    set(getParameterID(Param_LowCutTransition), (float) settings.lowCutShape.transition);
+    set(getParameterID(Param_LowCutAttenuation), (float) settings.lowCutShape.attenuation);
+    set(getParameterID(Param_HighCutType), (float) settings.highCutShape.family);
+    set(getParameterID(Param_HighCutTransition), (float) settings.highCutShape.transition);
+    set(getParameterID(Param_HighCutAttenuation), (float) settings.highCutShape.attenuation);
     
-    leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    updateCoefficients(leftChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    set(getParameterID(Param_LowCutBypassed), settings.lowCutBypassed ? 1.0f : 0.0f);
+    set(getParameterID(Param_HighCutBypassed), settings.highCutBypassed ? 1.0f : 0.0f);
     
-    leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    updateCoefficients(rightChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    for (size_t band = 0; band < maxBands; ++band) {
+        const auto& bandSettings = settings.bands[band];
+        set(getBandParameterID(band, BandParam_Freq), bandSettings.freq);
+        set(getBandParameterID(band, BandParam_Gain), bandSettings.gainDb);
+        set(getBandParameterID(band, BandParam_Quality), bandSettings.quality);
+        set(getBandParameterID(band, BandParam_Type), (float) bandSettings.type);
+        set(getBandParameterID(band, BandParam_Bypassed), bandSettings.bypassed ? 1.0f : 0.0f);
+        set(getBandParameterID(band, BandParam_Channel), (float) bandSettings.channel);
+        set(getBandParameterID(band, BandParam_Dynamic), bandSettings.dynamic ? 1.0f : 0.0f);
+        set(getBandParameterID(band, BandParam_Threshold), bandSettings.thresholdDb);
+        set(getBandParameterID(band, BandParam_Ratio), bandSettings.ratio);
+        set(getBandParameterID(band, BandParam_Attack), bandSettings.attackMs);
+        set(getBandParameterID(band, BandParam_Release), bandSettings.releaseMs);
+    }
+    
+    set(getParameterID(Param_FilterTopology), (float) settings.topology);
+    set(getParameterID(Param_ChannelMode), (float) settings.channelMode);
 }
 
-void EQAudioProcessor::updateLowCutFilters(const ChainSettings &chainSettings)
+ChainSettings EQAudioProcessor::getTargetSettings() const
 {
-    auto cutCoefficients = makeLowCutFilter(chainSettings, getSampleRate());
-    
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    updateCutFilter(leftLowCut, cutCoefficients, chainSettings.lowCutSlope);
-    
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
-    rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    updateCutFilter(rightLowCut, cutCoefficients, chainSettings.lowCutSlope);
+    return getTargetChainSettings(parameterHandles, [this](size_t slot, ChainSettings& settings)
+    {
+        return snapshots.read(slot, settings);
+    });
 }
 
-void EQAudioProcessor::updateHighCutFilters(const ChainSettings &chainSettings)
+void EQAudioProcessor::recallSnapshot(size_t slot)
 {
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
-    
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    updateCutFilter(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
-    
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
-    rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    ChainSettings snapshot;
+    if (snapshots.read(slot, snapshot))
+        setChainParameters(apvts, snapshot);
 }
 
-void EQAudioProcessor::updateFilters()
+CrossoverSettings getCrossoverSettings(const ParameterHandles& parameters)
 {
-    auto chainSettings = getChainSettings(apvts);
+    CrossoverSettings settings;
+    settings.numBands = (size_t) parameters.get(Param_CrossoverBands) + 1;
+    settings.steep = parameters.get(Param_CrossoverSlope) > 0.5f;
+    
+    for (size_t i = 0; i < maxCrossoverBands - 1; ++i)
+        settings.frequencies[i] = parameters.get(static_cast<GlobalParameter>(Param_CrossoverFreq1 + (int) i));
     
-    updateLowCutFilters(chainSettings);
-    updatePeakFilter(chainSettings);
-    updateHighCutFilters(chainSettings);
+    for (size_t band = 0; band < maxCrossoverBands; ++band) {
+        settings.gainDb[band] = parameters.get(band, CrossoverParam_Gain);
+        settings.muted[band] = parameters.isOn(band, CrossoverParam_Mute);
+        settings.soloed[band] = parameters.isOn(band, CrossoverParam_Solo);
+    }
+    
+    return settings;
 }
 
 //==============================================================================
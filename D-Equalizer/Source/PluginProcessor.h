@@ -9,8 +9,17 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "Crossover.h"
+#include "EQEngine.h"
+#include "Metering.h"
+#include "Parameters.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
 template<typename T>
 struct Fifo
 {
@@ -72,156 +81,194 @@ private:
     juce::AbstractFifo fifo {Capacity};
 };
 
-enum Channel
+enum AnalyzerLane
 {
-    Right, //effectively 0
-    Left //effectively 1
+    PostLeft,
+    PostRight,
+    PreLeft,
+    PreRight,
+    Sidechain,
+    NumAnalyzerLanes
 };
 
-template<typename BlockType>
-struct SingleChannelSampleFifo
+/*
+ Sample ring shared by all analyzer taps. Every sample of a block becomes one interleaved
+ frame holding all lanes, written by the audio thread in a single pass. The editor pulls
+ whole frames. When the ring is full (e.g. no editor open) the block is simply dropped.
+ */
+struct AnalyzerTapRing
 {
-    SingleChannelSampleFifo(Channel ch) : channelToUse(ch)
+    using LanePointers = std::array<const float*, NumAnalyzerLanes>;
+    
+    void prepare(int numFrames)
     {
         prepared.set(false);
+        frames.assign((size_t) numFrames * NumAnalyzerLanes, 0.f);
+        fifo.setTotalSize(numFrames);
+        fifo.reset();
+        prepared.set(true);
     }
     
-    void update(const BlockType& buffer)
+    //lanes left as nullptr are not written
+    void push(const LanePointers& lanes, int numSamples)
     {
-        jassert(prepared.get());
-        jassert(buffer.getNumChannels() > channelToUse );
-        auto* channelPtr = buffer.getReadPointer(channelToUse);
+        if( ! prepared.get() )
+            return;
         
-        for( int i = 0; i < buffer.getNumSamples(); ++i )
-        {
-            pushNextSampleIntoFifo(channelPtr[i]);
-        }
+        auto write = fifo.write(numSamples);
+        writeFrames(lanes, 0, write.startIndex1, write.blockSize1);
+        writeFrames(lanes, write.blockSize1, write.startIndex2, write.blockSize2);
     }
-
-    void prepare(int bufferSize)
+    
+    //copies up to 'maxFrames' interleaved frames into 'destination', returns the number of frames read
+    int pull(float* destination, int maxFrames)
     {
-        prepared.set(false);
-        size.set(bufferSize);
-        
-        bufferToFill.setSize(1,             //channel
-                             bufferSize,    //num samples
-                             false,         //keepExistingContent
-                             true,          //clear extra space
-                             true);         //avoid reallocating
-        audioBufferFifo.prepare(1, bufferSize);
-        fifoIndex = 0;
-        prepared.set(true);
+        auto read = fifo.read(maxFrames);
+        auto* end = std::copy_n(frames.data() + read.startIndex1 * NumAnalyzerLanes,
+                                read.blockSize1 * NumAnalyzerLanes,
+                                destination);
+        std::copy_n(frames.data() + read.startIndex2 * NumAnalyzerLanes,
+                    read.blockSize2 * NumAnalyzerLanes,
+                    end);
+        return read.blockSize1 + read.blockSize2;
     }
     //==============================================================================
-    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
+    int getNumFramesAvailable() const { return fifo.getNumReady(); }
     bool isPrepared() const { return prepared.get(); }
-    int getSize() const { return size.get(); }
-    //==============================================================================
-    bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
 private:
-    Channel channelToUse;
-    int fifoIndex = 0;
-    Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
+    std::vector<float> frames;
+    juce::AbstractFifo fifo {1};
     juce::Atomic<bool> prepared = false;
-    juce::Atomic<int> size = 0;
     
-    void pushNextSampleIntoFifo(float sample)
+    void writeFrames(const LanePointers& lanes, int sourceOffset, int startFrame, int numFrames)
     {
-        if (fifoIndex == bufferToFill.getNumSamples())
-        {
-            auto ok = audioBufferFifo.push(bufferToFill);
-
-            juce::ignoreUnused(ok);
-            
-            fifoIndex = 0;
-        }
+        if( numFrames <= 0 )
+            return;
+        
+        std::array<int, NumAnalyzerLanes> active;
+        int numActive = 0;
+        for( int lane = 0; lane < NumAnalyzerLanes; ++lane )
+            if( lanes[lane] != nullptr )
+                active[numActive++] = lane;
         
-        bufferToFill.setSample(0, fifoIndex, sample);
-        ++fifoIndex;
+        auto* frame = frames.data() + startFrame * NumAnalyzerLanes;
+        for( int i = sourceOffset; i < sourceOffset + numFrames; ++i, frame += NumAnalyzerLanes )
+            for( int a = 0; a < numActive; ++a )
+                frame[active[a]] = lanes[active[a]][i];
     }
 };
 
-// MonoChain
-using Filter = juce::dsp::IIR::Filter<float>;
-using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
-using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
-//A CutFilter is the series of four single Filter.
-//We have four different slopes for our CutFilter.
-
-enum ChainPositions
-{
-    LowCut,
-    Peak,
-    HighCut
-};
-
-enum Slope
+//==============================================================================
+//A timestamped automation point. samplePosition counts samples since prepareToPlay,
+//parameterIndex is the parameter's index in AudioProcessor::getParameters().
+struct ParameterChange
 {
-    Slope_12,
-    Slope_24,
-    Slope_36,
-    Slope_48
+    juce::int64 samplePosition;
+    int parameterIndex;
+    float normalisedValue;
 };
 
-struct ChainSettings
+//single producer, single consumer (the audio thread); changes must be pushed in time order
+struct ParameterChangeQueue
 {
-    float peakFreq{0}, peakGainDb{0}, peakQuality{1.0f};
-    float lowCutFreq{0}, highCutFreq{0};
-    Slope lowCutSlope{Slope::Slope_12}, highCutSlope{Slope::Slope_12};
-    bool lowCutBypassed {false}, peakBypassed {false}, highCutBypassed {false};
+    bool push(const ParameterChange& change)
+    {
+        auto write = fifo.write(1);
+        if( write.blockSize1 == 0 )
+            return false;
+        
+        changes[(size_t) write.startIndex1] = change;
+        return true;
+    }
+    
+    //the earliest pending change, or nullptr
+    const ParameterChange* peek() const
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(1, start1, size1, start2, size2);
+        return size1 > 0 ? &changes[(size_t) start1] : nullptr;
+    }
+    
+    void pop() { fifo.finishedRead(1); }
+    void clear() { fifo.reset(); }
+private:
+    static constexpr int capacity = 4096;
+    std::vector<ParameterChange> changes = std::vector<ParameterChange>(capacity);
+    juce::AbstractFifo fifo {capacity};
 };
 
-using Coefficients = Filter::CoefficientsPtr;
-void updateCoefficients(Coefficients& old, const Coefficients& replacements);
-
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate);
-
+//looks every parameter up first; getChainSettings(parameterHandles) is the one for the audio thread
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& aptvs);
 
-template<int Index, typename ChainType, typename CoefficientType>
-void update(ChainType& chain, const CoefficientType& coefficients)
-{
-    updateCoefficients(chain.template get<Index>().coefficients, coefficients[Index]);
-    chain.template setBypassed<Index>(false);
-}
+//writes a snapshot back to the parameters, notifying the host; message thread only
+void setChainParameters(juce::AudioProcessorValueTreeState& apvts, const ChainSettings& settings);
 
-template<typename ChainType, typename CoefficientType>
-void updateCutFilter(ChainType& chain, const CoefficientType& coefficients, const Slope& lowCutSlope)
+/*
+ Snapshot slots, A/B and beyond. A snapshot never changes once stored: store() publishes a
+ new copy through the slot's atomic pointer, and read() copies whichever is current with no
+ lock and no allocation. A replaced copy is retired rather than freed; it goes once no
+ read() is under way, at that store() or clear() or a later one, so the audio thread
+ never frees memory and never waits. Stores and clears come from the message thread (or
+ a host restoring its state), never from the audio thread.
+ */
+class SnapshotBank
 {
-    chain.template setBypassed<0>(true);
-    chain.template setBypassed<1>(true);
-    chain.template setBypassed<2>(true);
-    chain.template setBypassed<3>(true);
-    switch (lowCutSlope) {
-        case Slope_48:
-        {
-            update<3>(chain, coefficients);
-        }
-        case Slope_36:
-        {
-            update<2>(chain, coefficients);
-        }
-        case Slope_24:
-        {
-            update<1>(chain, coefficients);
-        }
-        case Slope_12:
-        {
-            update<0>(chain, coefficients);
-        }
+public:
+    void store(size_t slot, const ChainSettings& settings) { publish(slot, std::make_unique<const ChainSettings>(settings)); }
+    void clear(size_t slot) { publish(slot, nullptr); }
+    
+    //copies the slot's snapshot into 'settings'; false, leaving it alone, while the slot is empty
+    bool read(size_t slot, ChainSettings& settings) const noexcept
+    {
+        //counted before the load: a copy publish() sees no reader of can no longer be loaded
+        ++readers;
+        const auto* snapshot = slots[slot].load();
+        
+        if( snapshot != nullptr )
+            settings = *snapshot;
+        
+        --readers;
+        return snapshot != nullptr;
     }
-}
+    
+    bool has(size_t slot) const noexcept { return slots[slot].load() != nullptr; }
+    
+private:
+    using Snapshot = std::unique_ptr<const ChainSettings>;
+    
+    std::array<std::atomic<const ChainSettings*>, numSnapshotSlots> slots {};
+    mutable std::atomic<int> readers {0};
+    
+    juce::CriticalSection writeLock;
+    std::array<Snapshot, numSnapshotSlots> owned;     //what 'slots' point to, under writeLock
+    std::vector<Snapshot> retired;                     //under writeLock
+    
+    void publish(size_t slot, Snapshot snapshot)
+    {
+        const juce::ScopedLock sl (writeLock);
+        
+        slots[slot].store(snapshot.get());
+        retired.push_back(std::move(owned[slot]));
+        owned[slot] = std::move(snapshot);
+        
+        //a read() that starts after this check loads the new pointers, never a retired one
+        if( readers.load() == 0 )
+            retired.clear();
+    }
+};
 
-inline auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate)
+//Oversampled processing: the IIR chains run at 2x or 4x the host rate, between the
+//half-band polyphase IIR filters of juce::dsp::Oversampling, so the bilinear warping
+//near Nyquist moves out of the audible range. The value is the oversampling order.
+enum OversamplingFactor
 {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq, sampleRate, (chainSettings.lowCutSlope + 1) * 2);
-}
+    Oversampling_Off,
+    Oversampling_2x,
+    Oversampling_4x
+};
 
-inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate)
-{
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq, sampleRate, (chainSettings.highCutSlope + 1) * 2);
-}
+//==============================================================================
+CrossoverSettings getCrossoverSettings(const ParameterHandles& parameters);
 
 //==============================================================================
 /**
@@ -269,18 +316,152 @@ public:
     //AudioProcessorValueTreeState
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
+    const ParameterHandles parameterHandles {apvts};
     
-    using BlockType = juce::AudioBuffer<float>;
-    SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
-    SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
+    AnalyzerTapRing analyzerRing;
+    
+    //the pre-EQ analyzer tap is only captured while an editor asks for it
+    void setPreEqTapEnabled(bool shouldBeEnabled) { preEqTapEnabled.set(shouldBeEnabled); }
+    bool isPreEqTapEnabled() const { return preEqTapEnabled.get(); }
+    juce::uint32 getActiveAnalyzerLanes() const;
+    
+    bool isSidechainConnected() const;
+    
+    //meters are off by default; readings can be polled from any thread
+    void setMeterOptions(const MeterOptions& options);
+    MeterOptions getMeterOptions() const;
+    MeterReadings getMeterReadings(MeterTap tap) const { return meters[tap].getReadings(); }
+    
+    //Sample-accurate automation, e.g. from an offline renderer, pushed after prepareToPlay.
+    //Each change lands on the first point of the engine's absolute smoothingSubBlockSize grid at or
+    //after its position, so a render does not depend on the buffer size it runs with.
+    bool scheduleParameterChange(const ParameterChange& change) { return parameterChanges.push(change); }
+    
+    //the rate the IIR chains are designed for, the host rate times the oversampling factor
+    double getProcessingRate() const { return processingRate; }
+    
+    //Snapshots of the parameters for A/B comparison and morphing. storeSnapshot() and
+    //recallSnapshot() are for the message thread; a recall writes the parameters, so the
+    //host records it like any other edit.
+    void storeSnapshot(size_t slot) { snapshots.store(slot, getChainSettings(parameterHandles)); }
+    void recallSnapshot(size_t slot);
+    void clearSnapshot(size_t slot) { snapshots.clear(slot); }
+    bool hasSnapshot(size_t slot) const { return snapshots.has(slot); }
+    
+    //What the chains are designed from: the parameters, or with Morph Enabled the point
+    //between the Morph From and Morph To snapshots that Morph picks. An empty slot stands
+    //for the current parameters. Cheap enough for every grid point.
+    ChainSettings getTargetSettings() const;
     
 private:
-    MonoChain leftChain, rightChain;
+    //false for anything that is not a binary state blob of a known version
+    bool restoreBinaryState(const void* data, int sizeInBytes);
+    
+    SnapshotBank snapshots;
+    
+    //a new oversampling factor takes a prepareOversampling, done on the message thread
+    struct OversamplingReset : juce::AsyncUpdater
+    {
+        explicit OversamplingReset(EQAudioProcessor& p) : processor(p) {}
+        void handleAsyncUpdate() override;
+        
+        EQAudioProcessor& processor;
+    };
+    
+    std::array<std::unique_ptr<juce::dsp::Oversampling<float>>, 2> oversamplers;
+    OversamplingFactor preparedOversampling = Oversampling_Off;
+    int oversamplingFactor = 1;
+    double processingRate = 44100.0;
+    OversamplingReset oversamplingReset {*this};
+    
+    int getOversamplingLatency() const;
+    
+    //the oversampler, the engine at the processing rate, and the latency for them
+    void prepareOversampling(double sampleRate, int samplesPerBlock);
+    int getReportedLatency(LinearPhaseQuality quality);
+    void processOversampled(juce::dsp::AudioBlock<float>& block, const juce::AudioBuffer<float>& sidechain);
+    
+    //the designer works out the latency, the host hears about it on the message thread
+    struct LatencyUpdate : juce::AsyncUpdater
+    {
+        explicit LatencyUpdate(EQAudioProcessor& p) : processor(p) {}
+        void handleAsyncUpdate() override;
+        
+        EQAudioProcessor& processor;
+        juce::Atomic<int> latency {0};
+    };
+    
+    LatencyUpdate latencyUpdate {*this};
+    
+    //designs the FIR for the selected linear-phase quality whenever the settings change
+    struct LinearPhaseDesigner : juce::Thread
+    {
+        explicit LinearPhaseDesigner(EQAudioProcessor& p) : juce::Thread("Linear phase FIR"), processor(p) {}
+        void run() override;
+        
+        EQAudioProcessor& processor;
+    };
+    
+    //One convolution engine per quality, since the partition size is fixed at construction.
+    //Ready means an FIR was handed to the convolution, which loads it in the background.
+    std::array<std::unique_ptr<juce::dsp::Convolution>, 3> linearPhaseConvolutions;
+    std::array<juce::Atomic<bool>, 3> linearPhaseReady, linearPhaseMidSide;
+    std::array<juce::Atomic<int>, 3> linearPhaseFirSize;
+    LinearPhaseQuality runningLinearPhase = LinearPhaseOff;
+    
+    //Audio thread only: until the convolution actually runs the designed FIR, and its own
+    //crossfade into it is over, it warms up on a copy of the input and the IIR chains play.
+    static constexpr double convolutionFadeSeconds = 0.05;
+    juce::AudioBuffer<float> linearPhaseWarmupBuffer;
+    LinearPhaseQuality warmingLinearPhase = LinearPhaseOff;
+    int linearPhaseWarmupSamples = 0;
+    
+    //designer thread only
+    ChainSettings linearPhaseSettings;
+    LinearPhaseQuality linearPhaseDesigned = LinearPhaseOff;
+    
+    LinearPhaseDesigner linearPhaseDesigner {*this};
+    
+    juce::dsp::Convolution& getConvolution(LinearPhaseQuality quality) { return *linearPhaseConvolutions[(size_t) quality - 1]; }
+    int getLinearPhaseLatency(LinearPhaseQuality quality);
+    void designLinearPhase();
+    bool processLinearPhase(juce::dsp::AudioBlock<float>& block);
+    bool warmUpLinearPhase(LinearPhaseQuality quality, const juce::dsp::AudioBlock<float>& block);
+
+    //the IIR path, at processingRate; the processor only feeds it settings and automation
+    EQEngine engine;
+    
+    //applies the queued automation on the engine's grid, then hands it the settings
+    struct EngineSettings : EQEngine::GridListener
+    {
+        explicit EngineSettings(EQAudioProcessor& p) : processor(p) {}
+        void gridPointReached(juce::int64 position) override;
+        juce::int64 getNextChangePosition() const override;
+        
+        EQAudioProcessor& processor;
+    };
+    
+    EngineSettings engineSettings {*this};
+    
+    juce::AudioBuffer<float> preEqTapBuffer;
+    juce::Atomic<bool> preEqTapEnabled = false;
+    
+    std::array<LevelMeter, NumMeterTaps> meters;
+    juce::Atomic<bool> meterLevels = false, meterTruePeak = false, meterLoudness = false;
+    
+    //after the EQ and at the host rate, whatever the mode
+    LinkwitzRileyCrossover crossover;
+    CrossoverSettings crossoverSettings;
+    void processCrossover(juce::dsp::AudioBlock<float>& block);
+    
+    //the engine counts samples at the processing rate, ParameterChange positions stay at the host rate
+    ParameterChangeQueue parameterChanges;
+    void applyParameterChanges(juce::int64 position);
     
-    void updatePeakFilter(const ChainSettings& chainSettings);
-    void updateLowCutFilters(const ChainSettings& chainSettings);
-    void updateHighCutFilters(const ChainSettings& chainSettings);
-    void updateFilters();
+    //host samples before the engine's position 0: an oversampling change restarts the
+    //engine, not the automation's timeline
+    juce::int64 hostPositionOffset = 0;
+    juce::int64 getHostPosition(juce::int64 enginePosition) const { return hostPositionOffset + enginePosition / oversamplingFactor; }
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EQAudioProcessor)
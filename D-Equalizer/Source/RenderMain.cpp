@@ -0,0 +1,302 @@
+/*
+  ==============================================================================
+
+    RenderMain.cpp
+    deq-render: batch EQ of audio files on the command line, no GUI.
+
+  ==============================================================================
+*/
+
+#include "Benchmarks.h"
+#include "FFTBackend.h"
+#include "OfflineRender.h"
+#include "ParameterTable.h"
+
+#include <juce_data_structures/juce_data_structures.h>
+
+#include <iostream>
+#include <vector>
+
+static void printUsage()
+{
+    std::cout << "usage: deq-render [options] -o <dir> <input>...\n"
+                 "\n"
+                 "  -p, --preset <file>        a state saved by the plugin: binary, ValueTree or\n"
+                 "                             XML; with Morph Enabled, its snapshots are morphed\n"
+                 "                             as in the plugin\n"
+                 "  -s, --set \"<id>=<value>\"   one parameter, after the preset (repeatable),\n"
+                 "                             e.g. --set \"Peak Gain=-3\"\n"
+                 "  -o, --output <dir>         where the rendered files go, under the inputs' names\n"
+                 "  -f, --format <ext>         wav, flac or aiff; the input's format by default\n"
+                 "  -b, --bits <n>             output bit depth; the input's by default\n"
+                 "      --oversampling <n>     1, 2 or 4; the preset's by default\n"
+                 "      --block <n>            samples per block, 65536 by default\n"
+                 "  -j, --jobs <n>             worker threads, one per CPU by default; files and\n"
+                 "                             their channel groups are spread over them\n"
+                 "      --queue <n>            blocks in flight per file, 2 by default\n"
+                 "\n"
+                 "       deq-render --bench-fft [iterations]\n"
+                 "\n"
+                 "  times the analyzer's FFT backends at orders 11 to 13 and names the fastest\n"
+                 "\n"
+                 "       deq-render --bench [blocks]\n"
+                 "\n"
+                 "  times the filter topologies, cut slopes and families, dynamic bands and\n"
+                 "  oversampling factors at 48 kHz, in ns per sample of a stereo pair\n";
+}
+
+//relative to the working directory
+static juce::File getFile(const juce::String& path)
+{
+    return juce::File::getCurrentWorkingDirectory().getChildFile(path.unquoted());
+}
+
+static bool loadPreset(const juce::File& file, ParameterValues& values)
+{
+    juce::MemoryBlock data;
+    if (! file.loadFileAsData(data))
+        return false;
+
+    if (values.loadBinaryState(data.getData(), (int) data.getSize()))
+        return true;
+
+    //sessions saved before the binary format hold the plugin's whole ValueTree, as
+    //setStateInformation reads it; an XML file gives no valid tree or one with no PARAMs
+    const auto tree = juce::ValueTree::readFromData(data.getData(), data.getSize());
+    if (tree.isValid()) {
+        if (auto treeXml = tree.createXml())
+            if (values.loadXmlState(*treeXml))
+                return true;
+    }
+
+    auto xml = juce::parseXML(data.toString());
+    return xml != nullptr && values.loadXmlState(*xml);
+}
+
+//every backend this build has, at the analyzer's usual orders (2048 to 8192 points)
+static void benchmarkFFT(int numIterations)
+{
+    std::cout << "order   size  backend    complex ns    real ns\n";
+    
+    for (int order = 11; order <= 13; ++order) {
+        const auto results = benchmarkFFTBackends(order, numIterations);
+        const FFTBenchmarkResult* fastest = nullptr;
+        
+        for (const auto& result : results) {
+            std::cout << juce::String(order).paddedLeft(' ', 5) << juce::String(1 << order).paddedLeft(' ', 7)
+                      << "  " << juce::String(getFFTBackendName(result.type)).paddedRight(' ', 7)
+                      << juce::String(juce::roundToInt(result.nanosecondsPerComplexTransform)).paddedLeft(' ', 12)
+                      << juce::String(juce::roundToInt(result.nanosecondsPerRealTransform)).paddedLeft(' ', 11) << "\n";
+            
+            //the analyzer runs real transforms
+            if (fastest == nullptr || result.nanosecondsPerRealTransform < fastest->nanosecondsPerRealTransform)
+                fastest = &result;
+        }
+        
+        if (fastest != nullptr)
+            std::cout << "fastest at order " << order << ": " << getFFTBackendName(fastest->type) << "\n";
+    }
+    
+    std::cout << "default in this build: " << getFFTBackendName(getDefaultFFTBackendType()) << "\n";
+}
+
+static juce::String formatNanoseconds(double nanoseconds)
+{
+    return juce::String(nanoseconds, 2).paddedLeft(' ', 10);
+}
+
+//the chain benchmarks of Benchmarks.h, in 512-sample blocks
+static void benchmarkChains(int numBlocks)
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    
+    std::cout << "topology         parameters      ns\n";
+    for (const auto& result : benchmarkFilterTopologies(sampleRate, blockSize, numBlocks))
+        std::cout << juce::String(topologyChoices[(int) result.topology]).paddedRight(' ', 17)
+                  << juce::String(result.modulated ? "swept" : "static").paddedRight(' ', 10)
+                  << formatNanoseconds(result.nanosecondsPerSample) << "\n";
+    
+    std::cout << "\nlow cut slope            ns\n";
+    for (const auto& result : benchmarkCutSlopes(sampleRate, blockSize, numBlocks))
+        std::cout << juce::String(slopeChoices[(int) result.slope]).paddedRight(' ', 17)
+                  << formatNanoseconds(result.nanosecondsPerSample) << "\n";
+    
+    const CutShape shape;
+    
+    std::cout << "\nhigh cut family, " << transitionChoices[(int) shape.transition] << ", "
+              << attenuationChoices[(int) shape.attenuation] << "\n"
+              << "family           sections        ns\n";
+    for (const auto& result : benchmarkCutFamilies(shape, sampleRate, blockSize, numBlocks))
+        std::cout << juce::String(familyChoices[(int) result.shape.family]).paddedRight(' ', 17)
+                  << juce::String((int) result.numSections).paddedLeft(' ', 8)
+                  << formatNanoseconds(result.nanosecondsPerSample) << "\n";
+    
+    std::cout << "\nbands            detectors       ns\n";
+    for (const auto& result : benchmarkDynamicBands(maxBands, sampleRate, blockSize, numBlocks))
+        std::cout << juce::String((int) result.numBands).paddedRight(' ', 17)
+                  << juce::String(result.dynamic ? "on" : "off").paddedRight(' ', 10)
+                  << formatNanoseconds(result.nanosecondsPerSample) << "\n";
+    
+    std::cout << "\noversampling     x cpu           ns\n";
+    for (const auto& result : benchmarkOversampling(sampleRate, blockSize, numBlocks))
+        std::cout << (juce::String(result.factor) + "x").paddedRight(' ', 17)
+                  << juce::String(result.cpuMultiplier, 2).paddedRight(' ', 10)
+                  << formatNanoseconds(result.nanosecondsPerSample) << "\n";
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    if (args.size() == 0 || args.removeOptionIfFound("--help|-h")) {
+        printUsage();
+        return 0;
+    }
+    
+    if (args.containsOption("--bench")) {
+        const auto blocks = args.removeValueForOption("--bench").getIntValue();
+        benchmarkChains(blocks > 0 ? blocks : 2000);
+        return 0;
+    }
+    
+    if (args.containsOption("--bench-fft")) {
+        const auto iterations = args.removeValueForOption("--bench-fft").getIntValue();
+        benchmarkFFT(iterations > 0 ? iterations : 2000);
+        return 0;
+    }
+
+    ParameterValues values;
+
+    if (args.containsOption("--preset|-p")) {
+        const auto preset = getFile(args.removeValueForOption("--preset|-p"));
+        if (! loadPreset(preset, values)) {
+            std::cerr << "not a D-Equalizer state: " << preset.getFullPathName() << "\n";
+            return 1;
+        }
+    }
+
+    while (args.containsOption("--set|-s")) {
+        const auto assignment = args.removeValueForOption("--set|-s");
+        const auto id = assignment.upToLastOccurrenceOf("=", false, false).trim();
+
+        if (! assignment.contains("=") || ! values.set(id, assignment.fromLastOccurrenceOf("=", false, false).getFloatValue())) {
+            std::cerr << "unknown parameter: " << assignment << "\n";
+            return 1;
+        }
+    }
+
+    RenderOptions options;
+    options.settings = getTargetChainSettings(values, [&values](size_t slot, ChainSettings& settings)
+    {
+        return values.readSnapshot(slot, settings);
+    });
+    options.oversamplingOrder = (int) values.get(Param_Oversampling);
+
+    if (args.containsOption("--oversampling")) {
+        const auto factor = args.removeValueForOption("--oversampling").getIntValue();
+        if (factor != 1 && factor != 2 && factor != 4) {
+            std::cerr << "oversampling is 1, 2 or 4\n";
+            return 1;
+        }
+        options.oversamplingOrder = factor == 4 ? 2 : factor - 1;
+    }
+
+    if (args.containsOption("--block"))
+        options.blockSize = juce::jlimit(256, 1 << 20, args.removeValueForOption("--block").getIntValue());
+
+    if (args.containsOption("--bits|-b"))
+        options.bitsPerSample = args.removeValueForOption("--bits|-b").getIntValue();
+
+    const auto numJobs = args.containsOption("--jobs|-j") ? juce::jmax(1, args.removeValueForOption("--jobs|-j").getIntValue())
+                                                          : juce::SystemStats::getNumCpus();
+
+    BatchOptions batchOptions;
+    batchOptions.numWorkers = numJobs;
+    if (args.containsOption("--queue"))
+        batchOptions.queueDepth = juce::jlimit(1, 64, args.removeValueForOption("--queue").getIntValue());
+
+    const auto format = args.containsOption("--format|-f") ? args.removeValueForOption("--format|-f").trimCharactersAtStart(".") : juce::String();
+
+    if (! args.containsOption("--output|-o")) {
+        std::cerr << "no --output directory\n";
+        return 1;
+    }
+
+    const auto outputDirectory = getFile(args.removeValueForOption("--output|-o"));
+    if (! outputDirectory.createDirectory()) {
+        std::cerr << "cannot create " << outputDirectory.getFullPathName() << "\n";
+        return 1;
+    }
+
+    //what the plugin would do on top of the IIR chains is left out, not approximated
+    if ((int) values.get(Param_LinearPhase) != 0)
+        std::cerr << "note: linear phase is not rendered, the IIR chains are used\n";
+    if ((int) values.get(Param_CrossoverBands) != 0)
+        std::cerr << "note: the crossover is not rendered\n";
+
+    if (values.isOn(Param_MorphEnabled)) {
+        ChainSettings unused;
+        for (auto parameter : { Param_MorphFrom, Param_MorphTo }) {
+            const auto slot = (size_t) values.get(parameter);
+            if (! values.readSnapshot(slot, unused))
+                std::cerr << "note: snapshot " << snapshotChoices[slot] << " is empty, the parameters stand in for it\n";
+        }
+    }
+
+    std::vector<BatchJob> jobs;
+
+    for (const auto& arg : args.arguments) {
+        const auto input = getFile(arg.text);
+        jobs.push_back({ input, outputDirectory.getChildFile(format.isEmpty() ? input.getFileName()
+                                                                              : input.getFileNameWithoutExtension() + "." + format) });
+    }
+
+    //one worker gains nothing from the pipeline, and renders the files one after the other
+    BatchReport report;
+
+    if (numJobs == 1) {
+        const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+        const auto checks = checkBatchJobs(jobs);
+
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            RenderStats stats;
+            report.results.push_back(checks[i].failed() ? checks[i] : renderFile(jobs[i].input, jobs[i].output, options, &stats));
+            report.files.push_back(stats);
+        }
+
+        report.seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    } else {
+        report = renderBatch(jobs, options, batchOptions);
+    }
+
+    int numFailed = 0;
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const auto& result = report.results[i];
+        const auto& stats = report.files[i];
+
+        if (result.failed()) {
+            std::cerr << jobs[i].input.getFileName() << ": " << result.getErrorMessage() << "\n";
+            ++numFailed;
+            continue;
+        }
+
+        std::cout << jobs[i].input.getFileName() << " -> " << jobs[i].output.getFullPathName()
+                  << "  " << stats.numChannels << " ch, " << juce::String(stats.seconds, 2) << " s, "
+                  << juce::String(stats.getRealtimeFactor(), 1) << "x realtime\n";
+    }
+
+    for (size_t w = 0; w < report.workers.size(); ++w) {
+        const auto& worker = report.workers[w];
+        std::cout << "worker " << (w + 1) << ": " << worker.tasks << " tasks (" << worker.stolen << " stolen), "
+                  << worker.work << " samples, " << juce::String(worker.getWorkPerSecond() / 1.0e6, 1) << " M samples/s busy\n";
+    }
+
+    if (report.seconds > 0.0)
+        std::cout << "total: " << report.getNumSamples() << " samples in " << juce::String(report.seconds, 2) << " s, "
+                  << juce::String((double) report.getNumSamples() / report.seconds / 1.0e6, 1) << " M samples/s\n";
+
+    return numFailed == 0 ? 0 : 1;
+}
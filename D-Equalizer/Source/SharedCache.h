@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    SharedCache.h
+    Process-wide cache of immutable resources, shared by every plugin
+    instance in the process.
+
+    Each Key/Value pair has one cache. It only holds weak references, so a
+    resource lives exactly as long as some instance is using it: the first
+    editor that asks for a 2048-point FFT builds it, the others get the same
+    object, and it is freed when the last of them closes. Values are const;
+    anything an instance writes to (scratch buffers, filter state) stays with
+    that instance.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <map>
+#include <memory>
+
+template<typename Key, typename Value>
+class SharedCache
+{
+public:
+    using Pointer = std::shared_ptr<const Value>;
+
+    static SharedCache& getInstance()
+    {
+        static SharedCache cache;
+        return cache;
+    }
+
+    //the cached value for 'key', or a new one from create() if no one holds it any more
+    template<typename Factory>
+    Pointer get(const Key& key, Factory&& create)
+    {
+        const juce::ScopedLock sl (lock);
+
+        removeExpired();
+
+        auto& entry = entries[key];
+        if( auto value = entry.lock() )
+            return value;
+
+        Pointer value = create();
+        entry = value;
+        return value;
+    }
+
+    //resources currently alive
+    size_t size()
+    {
+        const juce::ScopedLock sl (lock);
+        removeExpired();
+        return entries.size();
+    }
+
+private:
+    SharedCache() = default;
+
+    void removeExpired()
+    {
+        for( auto it = entries.begin(); it != entries.end(); )
+            it = it->second.expired() ? entries.erase(it) : std::next(it);
+    }
+
+    juce::CriticalSection lock;
+    std::map<Key, std::weak_ptr<const Value>> entries;
+
+    JUCE_DECLARE_NON_COPYABLE(SharedCache)
+};
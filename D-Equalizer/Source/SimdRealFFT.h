@@ -0,0 +1,233 @@
+/*
+  ==============================================================================
+
+    SimdRealFFT.h
+    Header-only radix-2 FFT used by the analyzer when neither the platform
+    library (vDSP / IPP) nor FFTW is available.
+
+    The complex transform is a Stockham autosort FFT on split real/imaginary
+    arrays: every stage reads and writes contiguous runs, so the butterflies
+    run on full SIMD registers once the run length reaches the register width
+    and no bit-reversal pass is needed. Real input is transformed as a complex
+    sequence of half the length followed by a split step.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "SharedCache.h"
+
+#include <array>
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <vector>
+
+class SimdRealFFT
+{
+public:
+    using Complex = std::complex<float>;
+
+    explicit SimdRealFFT(int order)
+        : size(1 << order),
+          halfSize(size / 2),
+          twiddles(SharedCache<int, Twiddles>::getInstance().get(order, [order] { return std::make_shared<const Twiddles>(order); }))
+    {
+        jassert( order >= 2 );
+
+        for( auto* buffer : { &re, &im, &workRe, &workIm } )
+            buffer->allocate(size);
+    }
+
+    int getSize() const noexcept { return size; }
+
+    /* complex forward transform of getSize() points, unscaled. */
+    void performComplexForward(const Complex* input, Complex* output) noexcept
+    {
+        for( int i = 0; i < size; ++i )
+        {
+            re[i] = input[i].real();
+            im[i] = input[i].imag();
+        }
+
+        auto result = transform(size, twiddles->re.get(), twiddles->im.get());
+
+        for( int i = 0; i < size; ++i )
+            output[i] = Complex(result[0][i], result[1][i]);
+    }
+
+    /* real forward transform of getSize() samples into getSize() / 2 + 1 bins, unscaled. */
+    void performRealForward(const float* input, Complex* output) noexcept
+    {
+        //even samples into the real part, odd samples into the imaginary part
+        for( int i = 0; i < halfSize; ++i )
+        {
+            re[i] = input[2 * i];
+            im[i] = input[2 * i + 1];
+        }
+
+        auto result = transform(halfSize, twiddles->halfRe.get(), twiddles->halfIm.get());
+        const auto* zRe = result[0];
+        const auto* zIm = result[1];
+
+        //X[k] = E[k] + w^k O[k], with E and O recovered from Z[k] and conj(Z[N/2 - k])
+        for( int k = 0; k <= halfSize; ++k )
+        {
+            const int a = k % halfSize;
+            const int b = (halfSize - k) % halfSize;
+
+            const Complex z (zRe[a], zIm[a]);
+            const Complex zMirror (zRe[b], -zIm[b]);
+
+            const auto even = (z + zMirror) * 0.5f;
+            const auto odd = (z - zMirror) * Complex(0.f, -0.5f);
+            const auto w = k < size / 2 ? Complex(twiddles->re[k], twiddles->im[k]) : Complex(-1.f, 0.f);
+
+            output[k] = even + w * odd;
+        }
+    }
+
+private:
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<float>;
+    static constexpr int vecSize = (int) Vec::SIMDNumElements;
+   #endif
+
+    /*
+     transforms the first 'n' points held in re/im, the twiddle tables hold
+     exp(-2 pi i k / n) for k < n / 2. Returns {real, imag} of the result.
+     */
+    std::array<float*, 2> transform(int n, const float* wRe, const float* wIm) noexcept
+    {
+        float* xRe = re.get();
+        float* xIm = im.get();
+        float* yRe = workRe.get();
+        float* yIm = workIm.get();
+
+        //each stage halves the sub-transform length 'len' and doubles the run length 's'
+        for( int len = n, s = 1; len > 1; len /= 2, s *= 2 )
+        {
+            const int m = len / 2;
+
+            for( int p = 0; p < m; ++p )
+            {
+                const auto cRe = wRe[p * s];
+                const auto cIm = wIm[p * s];
+
+                const float* aRe = xRe + s * p;
+                const float* aIm = xIm + s * p;
+                const float* bRe = xRe + s * (p + m);
+                const float* bIm = xIm + s * (p + m);
+                float* sumRe = yRe + s * (2 * p);
+                float* sumIm = yIm + s * (2 * p);
+                float* difRe = yRe + s * (2 * p + 1);
+                float* difIm = yIm + s * (2 * p + 1);
+
+                int q = 0;
+
+               #if JUCE_USE_SIMD
+                if( s >= vecSize )
+                {
+                    const auto vcRe = Vec::expand(cRe);
+                    const auto vcIm = Vec::expand(cIm);
+
+                    for( ; q < s; q += vecSize )
+                    {
+                        const auto ar = Vec::fromRawArray(aRe + q);
+                        const auto ai = Vec::fromRawArray(aIm + q);
+                        const auto br = Vec::fromRawArray(bRe + q);
+                        const auto bi = Vec::fromRawArray(bIm + q);
+
+                        (ar + br).copyToRawArray(sumRe + q);
+                        (ai + bi).copyToRawArray(sumIm + q);
+
+                        const auto dr = ar - br;
+                        const auto di = ai - bi;
+                        (dr * vcRe - di * vcIm).copyToRawArray(difRe + q);
+                        (dr * vcIm + di * vcRe).copyToRawArray(difIm + q);
+                    }
+                }
+               #endif
+
+                for( ; q < s; ++q )
+                {
+                    const auto ar = aRe[q], ai = aIm[q];
+                    const auto br = bRe[q], bi = bIm[q];
+
+                    sumRe[q] = ar + br;
+                    sumIm[q] = ai + bi;
+
+                    const auto dr = ar - br;
+                    const auto di = ai - bi;
+                    difRe[q] = dr * cRe - di * cIm;
+                    difIm[q] = dr * cIm + di * cRe;
+                }
+            }
+
+            std::swap(xRe, yRe);
+            std::swap(xIm, yIm);
+        }
+
+        return { xRe, xIm };
+    }
+
+    /* SIMD-aligned scratch array */
+    struct AlignedBuffer
+    {
+        void allocate(int numElements)
+        {
+            storage.calloc((size_t) numElements + 16);
+           #if JUCE_USE_SIMD
+            data = juce::dsp::SIMDRegister<float>::getNextSIMDAlignedPtr(storage.get());
+           #else
+            data = storage.get();
+           #endif
+        }
+
+        float* get() const noexcept { return data; }
+        float& operator[](int i) noexcept { return data[i]; }
+        float operator[](int i) const noexcept { return data[i]; }
+
+    private:
+        juce::HeapBlock<float> storage;
+        float* data = nullptr;
+    };
+
+    //twiddles depend on the size only, every transform of one size shares them
+    struct Twiddles
+    {
+        explicit Twiddles(int order)
+        {
+            const int size = 1 << order;
+
+            //twiddles of the full-size complex transform, w^k = exp(-2 pi i k / size)
+            re.allocate(size / 2);
+            im.allocate(size / 2);
+            for( int k = 0; k < size / 2; ++k )
+            {
+                const auto angle = -2.0 * juce::MathConstants<double>::pi * k / size;
+                re[k] = (float) std::cos(angle);
+                im[k] = (float) std::sin(angle);
+            }
+
+            //twiddles of the half-size transform used by the real transform are every other one
+            halfRe.allocate(size / 4);
+            halfIm.allocate(size / 4);
+            for( int k = 0; k < size / 4; ++k )
+            {
+                halfRe[k] = re[2 * k];
+                halfIm[k] = im[2 * k];
+            }
+        }
+
+        AlignedBuffer re, im, halfRe, halfIm;
+    };
+
+    const int size, halfSize;
+    const std::shared_ptr<const Twiddles> twiddles;
+    AlignedBuffer re, im, workRe, workIm;
+
+    JUCE_DECLARE_NON_COPYABLE(SimdRealFFT)
+};
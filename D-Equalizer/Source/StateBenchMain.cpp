@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+
+    StateBenchMain.cpp
+    deq-state-bench: the per-instance cost of setStateInformation for a session
+    with every band in use, legacy ValueTree state against the binary one.
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+struct StateRestoreBenchmarkResult
+{
+    bool binary;
+    size_t stateBytes;
+    double microsecondsPerRestore;
+};
+
+static std::vector<StateRestoreBenchmarkResult> benchmarkStateRestore(int numInstances)
+{
+    std::vector<StateRestoreBenchmarkResult> results;
+
+    //a busy session: every band enabled and moved away from its defaults
+    EQAudioProcessor source;
+    for (size_t band = 0; band < maxBands; ++band) {
+        for (auto parameter : { BandParam_Bypassed, BandParam_Gain, BandParam_Dynamic }) {
+            if (auto* ranged = source.apvts.getParameter(getBandParameterID(band, parameter)))
+                ranged->setValue(parameter == BandParam_Bypassed ? 0.0f : 0.75f);
+        }
+    }
+
+    juce::MemoryBlock binaryState, legacyState;
+    source.getStateInformation(binaryState);
+    {
+        juce::MemoryOutputStream mos(legacyState, false);
+        source.apvts.copyState().writeToStream(mos);
+    }
+
+    for (auto binary : { false, true }) {
+        const auto& state = binary ? binaryState : legacyState;
+
+        std::vector<std::unique_ptr<EQAudioProcessor>> instances;
+        for (int i = 0; i < numInstances; ++i)
+            instances.push_back(std::make_unique<EQAudioProcessor>());
+
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (auto& instance : instances)
+            instance->setStateInformation(state.getData(), (int) state.getSize());
+
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        results.push_back({ binary, state.getSize(), elapsed * 1.0e6 / juce::jmax(1, numInstances) });
+    }
+
+    return results;
+}
+
+int main(int argc, char* argv[])
+{
+    //the processors' parameters and timers need the message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    const auto instances = argc > 1 ? juce::jmax(1, juce::String(argv[1]).getIntValue()) : 64;
+
+    std::cout << "state            bytes           us per restore\n";
+    for (const auto& result : benchmarkStateRestore(instances))
+        std::cout << juce::String(result.binary ? "binary" : "ValueTree").paddedRight(' ', 17)
+                  << juce::String((int) result.stateBytes).paddedRight(' ', 16)
+                  << juce::String(result.microsecondsPerRestore, 1) << "\n";
+
+    return 0;
+}
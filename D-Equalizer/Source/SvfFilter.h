@@ -0,0 +1,224 @@
+/*
+  ==============================================================================
+
+    SvfFilter.h
+    Topology-preserving-transform state-variable filter (Cytomic / Zavalishin)
+    that can stand in for a juce::dsp::IIR::Filter biquad in the EQ chains.
+
+    Its state holds the two integrator memories rather than past outputs, so
+    the cutoff can move on every sample without blowing up or clicking. A
+    cutoff change costs a table lookup of tan() per sample, not a new design.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+namespace SvfHelpers
+{
+    //highest normalised frequency the filters are tuned to, just under Nyquist
+    constexpr float maxNormalisedFrequency = 0.49f;
+
+    //a new cutoff is reached over this many samples, the processor's smoothing grid
+    constexpr int glideSamples = 32;
+
+    //tan(pi * f / sampleRate) for normalised frequencies 0 ... maxNormalisedFrequency
+    inline const juce::dsp::LookupTableTransform<float>& getTanTable()
+    {
+        static const juce::dsp::LookupTableTransform<float> table ([](float x)
+                                                                   {
+                                                                       return std::tan(juce::MathConstants<float>::pi * x);
+                                                                   },
+                                                                   0.0f, maxNormalisedFrequency, 4096);
+        return table;
+    }
+
+    inline float prewarp(float normalisedFrequency)
+    {
+        return getTanTable().processSampleUnchecked(juce::jlimit(0.0f, maxNormalisedFrequency, normalisedFrequency));
+    }
+}
+
+/*
+ Response of an SvfFilter: out = m0 * input + m1 * bandpass + m2 * lowpass.
+ The shelves tune the integrators off the nominal frequency by gScale.
+ Like IIR::Coefficients it is reference counted, so several filters can share one.
+ */
+struct SvfParameters : juce::ReferenceCountedObject
+{
+    using Ptr = juce::ReferenceCountedObjectPtr<SvfParameters>;
+
+    void setLowPass(float frequency, float inverseQ)
+    {
+        normalisedFrequency = frequency;
+        gScale = 1.0f;
+        k = inverseQ;
+        m0 = 0.0f; m1 = 0.0f; m2 = 1.0f;
+    }
+
+    void setHighPass(float frequency, float inverseQ)
+    {
+        normalisedFrequency = frequency;
+        gScale = 1.0f;
+        k = inverseQ;
+        m0 = 1.0f; m1 = -inverseQ; m2 = -1.0f;
+    }
+
+    void setBell(float frequency, float q, float gainDb)
+    {
+        const auto A = std::pow(10.0f, gainDb / 40.0f);
+
+        normalisedFrequency = frequency;
+        gScale = 1.0f;
+        k = 1.0f / (q * A);
+        m0 = 1.0f; m1 = k * (A * A - 1.0f); m2 = 0.0f;
+    }
+    
+    void setLowShelf(float frequency, float q, float gainDb)
+    {
+        const auto A = std::pow(10.0f, gainDb / 40.0f);
+        
+        normalisedFrequency = frequency;
+        gScale = 1.0f / std::sqrt(A);
+        k = 1.0f / q;
+        m0 = 1.0f; m1 = k * (A - 1.0f); m2 = A * A - 1.0f;
+    }
+    
+    void setHighShelf(float frequency, float q, float gainDb)
+    {
+        const auto A = std::pow(10.0f, gainDb / 40.0f);
+        
+        normalisedFrequency = frequency;
+        gScale = std::sqrt(A);
+        k = 1.0f / q;
+        m0 = A * A; m1 = k * (1.0f - A) * A; m2 = 1.0f - A * A;
+    }
+    
+    void setNotch(float frequency, float q)
+    {
+        normalisedFrequency = frequency;
+        gScale = 1.0f;
+        k = 1.0f / q;
+        m0 = 1.0f; m1 = -k; m2 = 0.0f;
+    }
+    
+    //a high shelf turned down by half its gain, so the lows drop as much as the highs rise
+    void setTilt(float frequency, float q, float gainDb)
+    {
+        setHighShelf(frequency, q, gainDb);
+        
+        const auto halfGain = std::pow(10.0f, -gainDb / 40.0f);
+        m0 *= halfGain; m1 *= halfGain; m2 *= halfGain;
+    }
+
+    //cutoff divided by the sample rate
+    float normalisedFrequency = 0.25f, gScale = 1.0f;
+    float k = 1.0f, m0 = 1.0f, m1 = 0.0f, m2 = 0.0f;
+};
+
+class SvfFilter
+{
+public:
+    SvfFilter() : parameters(new SvfParameters()) {}
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        jassert(spec.numChannels == 1);
+        juce::ignoreUnused(spec);
+
+        SvfHelpers::getTanTable(); //built here rather than on the audio thread
+        reset();
+    }
+
+    //clears the state and jumps straight to the current parameters
+    void reset()
+    {
+        ic1eq = ic2eq = 0.0f;
+        currentFrequency = glideTarget = parameters->normalisedFrequency;
+        glideRemaining = 0;
+    }
+
+    /*
+     processes a mono block. A new cutoff is reached linearly over the next
+     glideSamples samples, with a fresh prewarp on every one of them. The glide
+     carries over between calls, so the output does not depend on how the
+     audio is split into blocks.
+     */
+    template<typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+
+        jassert(inputBlock.getNumChannels() == 1 && outputBlock.getNumChannels() == 1);
+
+        const auto numSamples = (int) inputBlock.getNumSamples();
+
+        if( context.isBypassed )
+        {
+            if( context.usesSeparateInputAndOutputBlocks() )
+                outputBlock.copyFrom(inputBlock);
+            return;
+        }
+
+        const auto* input = inputBlock.getChannelPointer(0);
+        auto* output = outputBlock.getChannelPointer(0);
+
+        const auto& p = *parameters;
+
+        if( p.normalisedFrequency != glideTarget )
+        {
+            glideTarget = p.normalisedFrequency;
+            glideStep = (glideTarget - currentFrequency) / (float) SvfHelpers::glideSamples;
+            glideRemaining = SvfHelpers::glideSamples;
+        }
+
+        int i = 0;
+
+        for( ; i < numSamples && glideRemaining > 0; ++i, --glideRemaining )
+        {
+            currentFrequency = glideRemaining == 1 ? glideTarget : currentFrequency + glideStep;
+
+            const auto g = SvfHelpers::prewarp(currentFrequency) * p.gScale;
+            const auto a1 = 1.0f / (1.0f + g * (g + p.k));
+
+            output[i] = processSample(input[i], g, a1, p);
+        }
+
+        if( i < numSamples )
+        {
+            const auto g = SvfHelpers::prewarp(currentFrequency) * p.gScale;
+            const auto a1 = 1.0f / (1.0f + g * (g + p.k));
+
+            for( ; i < numSamples; ++i )
+                output[i] = processSample(input[i], g, a1, p);
+        }
+
+        juce::dsp::util::snapToZero(ic1eq);
+        juce::dsp::util::snapToZero(ic2eq);
+    }
+
+    SvfParameters::Ptr parameters;
+
+private:
+    float processSample(float v0, float g, float a1, const SvfParameters& p) noexcept
+    {
+        const auto a2 = g * a1;
+        const auto a3 = g * a2;
+
+        const auto v3 = v0 - ic2eq;
+        const auto v1 = a1 * ic1eq + a2 * v3;
+        const auto v2 = ic2eq + a2 * ic1eq + a3 * v3;
+
+        ic1eq = 2.0f * v1 - ic1eq;
+        ic2eq = 2.0f * v2 - ic2eq;
+
+        return p.m0 * v0 + p.m1 * v1 + p.m2 * v2;
+    }
+
+    float ic1eq = 0.0f, ic2eq = 0.0f;
+    float currentFrequency = 0.25f, glideTarget = 0.25f, glideStep = 0.0f;
+    int glideRemaining = 0;
+};
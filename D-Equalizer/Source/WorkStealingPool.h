@@ -0,0 +1,210 @@
+/*
+  ==============================================================================
+
+    WorkStealingPool.h
+    A fixed set of worker threads, each with its own task queue.
+
+    A task submitted from a worker goes on that worker's queue, which it runs
+    newest first, so a task's follow-ups tend to run where its data is still
+    in cache. A worker with nothing left takes the oldest task of another
+    queue. Tasks submitted from outside the pool are dealt out round robin.
+    The queues are short and mostly touched by their owner, so each one is
+    just a locked deque.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class WorkStealingPool
+{
+public:
+    //returns the work it did, in whatever unit the caller reports (e.g. samples), for the statistics
+    using Task = std::function<juce::int64()>;
+
+    struct WorkerStats
+    {
+        juce::int64 tasks = 0, stolen = 0, work = 0;
+        double busySeconds = 0.0;
+
+        double getWorkPerSecond() const { return busySeconds > 0.0 ? (double) work / busySeconds : 0.0; }
+    };
+
+    explicit WorkStealingPool(int numWorkers)
+    {
+        for( int i = 0; i < juce::jmax(1, numWorkers); ++i )
+            workers.push_back(std::make_unique<Worker>(*this, i));
+
+        for( auto& worker : workers )
+            worker->startThread();
+    }
+
+    ~WorkStealingPool()
+    {
+        stop();
+    }
+
+    //Joins the workers: tasks still queued are dropped, the running ones are finished
+    //first. The statistics stay readable afterwards.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock (idleMutex);
+            stopping = true;
+        }
+        idle.notify_all();
+
+        for( auto& worker : workers )
+            worker->stopThread(-1);
+    }
+
+    int getNumWorkers() const { return (int) workers.size(); }
+
+    void submit(Task task)
+    {
+        auto index = getCurrentWorker() == this ? getCurrentWorkerIndex() : -1;
+        if( index < 0 )
+            index = (int) (nextQueue++ % workers.size());
+
+        {
+            auto& queue = workers[(size_t) index]->queue;
+            std::lock_guard<std::mutex> lock (queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock (idleMutex);
+            ++pending;
+        }
+        idle.notify_one();
+    }
+
+    //each worker's counts so far; exact once every task has returned
+    std::vector<WorkerStats> getStats() const
+    {
+        std::vector<WorkerStats> stats;
+        for( auto& worker : workers )
+        {
+            std::lock_guard<std::mutex> lock (worker->queue.mutex);
+            stats.push_back(worker->stats);
+        }
+        return stats;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct Worker : juce::Thread
+    {
+        Worker(WorkStealingPool& p, int i) : juce::Thread("Render worker " + juce::String(i + 1)), pool(p), index(i) {}
+        void run() override { pool.runWorker(index); }
+
+        WorkStealingPool& pool;
+        const int index;
+        Queue queue;
+        WorkerStats stats;      //under queue.mutex
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> nextQueue {0};
+
+    std::mutex idleMutex;
+    std::condition_variable idle;
+    std::atomic<int> pending {0};
+    bool stopping = false;      //under idleMutex
+
+    static WorkStealingPool*& getCurrentWorker()
+    {
+        static thread_local WorkStealingPool* pool = nullptr;
+        return pool;
+    }
+
+    static int& getCurrentWorkerIndex()
+    {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    //own queue newest first, then the others oldest first
+    bool take(int index, Task& task, bool& stolen)
+    {
+        const auto numWorkers = (int) workers.size();
+
+        for( int i = 0; i < numWorkers; ++i )
+        {
+            auto& queue = workers[(size_t) ((index + i) % numWorkers)]->queue;
+            std::lock_guard<std::mutex> lock (queue.mutex);
+
+            if( queue.tasks.empty() )
+                continue;
+
+            stolen = i > 0;
+            if( stolen )
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            else
+            {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+
+            --pending;
+            return true;
+        }
+
+        return false;
+    }
+
+    void runWorker(int index)
+    {
+        getCurrentWorker() = this;
+        getCurrentWorkerIndex() = index;
+
+        auto& worker = *workers[(size_t) index];
+
+        for( ;; )
+        {
+            Task task;
+            bool stolen = false;
+
+            if( ! take(index, task, stolen) )
+            {
+                std::unique_lock<std::mutex> lock (idleMutex);
+                idle.wait(lock, [this] { return pending > 0 || stopping; });
+
+                if( stopping )
+                    return;
+
+                continue;
+            }
+
+            const auto start = juce::Time::getMillisecondCounterHiRes();
+            const auto work = task();
+            const auto busySeconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+            std::lock_guard<std::mutex> lock (worker.queue.mutex);
+            worker.stats.tasks += 1;
+            worker.stats.stolen += stolen ? 1 : 0;
+            worker.stats.work += work;
+            worker.stats.busySeconds += busySeconds;
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(WorkStealingPool)
+};